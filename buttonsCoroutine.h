@@ -0,0 +1,396 @@
+/*
+ *  Arduino Buttons Template Library - C++20 coroutine support
+ *  Awaitables that suspend a coroutine until a button event happens.
+ *
+ *  Copyright (C) 2017 Vital Holmo Batista
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+#include <buttonsTemplate.h>
+
+// Only available on toolchains with C++20 coroutines (e.g. ARM/ESP32 cores built with -std=gnu++20).
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+
+/**
+* Coroutine frame pool size. Frames are never allocated from the heap: each running
+* ButtonTask takes one slot of BUTTON_TASK_FRAME_SIZE bytes from a static pool.
+* A frame holds the locals and awaiters of its coroutine, so its size depends on the coroutine
+* and grows with the pointer width: as one measured example, the four-await coroutine of
+* extras/test/test_coroutine.cpp takes 184 bytes on 32-bit targets and 336 bytes on 64-bit hosts.
+* The default, 64 pointers, fits that example with room to spare; check the actual need
+* of your own coroutines with ButtonTask::frameSizeNeeded().
+* Can be overridden in user files by #defining them before including this file.
+*/
+#ifndef BUTTON_TASK_POOL_SIZE
+#define BUTTON_TASK_POOL_SIZE 4
+#endif
+#ifndef BUTTON_TASK_FRAME_SIZE
+#define BUTTON_TASK_FRAME_SIZE (64 * sizeof(void*))
+#endif
+
+/**
+* Events a coroutine can wait for. Each event also has a bit in the waiter masks.
+*/
+enum class ButtonEvent : uint8_t
+{
+	None,
+	Clicked,
+	DoubleClicked,
+	ShortReleased,
+	LongReleased,
+	Timeout,
+	Rotated
+};
+
+/**
+* Result of a co_await on a ButtonsAwait awaitable.
+*/
+struct ButtonEventInfo
+{
+	/**
+	* Index of the button that raised the event, or ButtonEventInfo::NO_BUTTON on timeout.
+	*/
+	uint16_t buttonId;
+	ButtonEvent event;
+
+	/**
+	* ISR-captured time of the press or release (BUTTONS_NOW() ticks), and for releases the
+	* exact duration of the press. Both are 0 on timeout.
+	*/
+	unsigned long time;
+	unsigned long duration;
+
+	/**
+	* Detents turned since the previous read, for ButtonEvent::Rotated (then time is that of
+	* the last detent, from millis()). 0 for the other events.
+	*/
+	int16_t steps;
+
+	static constexpr uint16_t NO_BUTTON = 0xFFFF;
+};
+
+/**
+ * Return type for coroutines that wait on button events.
+ * The coroutine starts running immediately when called and destroys itself when it returns,
+ * so there is no handle to keep. Its frame comes from a static pool; if the pool is exhausted
+ * or the frame is larger than BUTTON_TASK_FRAME_SIZE, the coroutine is not started and
+ * started() returns false (see frameSizeNeeded()).
+ */
+class ButtonTask final
+{
+public:
+	struct promise_type
+	{
+		ButtonTask get_return_object() noexcept { return ButtonTask(true); }
+		static ButtonTask get_return_object_on_allocation_failure() noexcept { return ButtonTask(false); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept {}
+
+		static void* operator new(size_t size) noexcept
+		{
+			if (size > _frameSizeNeeded) _frameSizeNeeded = size;
+			if (size > BUTTON_TASK_FRAME_SIZE) return nullptr;
+			for (uint8_t i = 0; i < BUTTON_TASK_POOL_SIZE; i++)
+			{
+				if (!_frameUsed[i])
+				{
+					_frameUsed[i] = true;
+					// Hides that the frame is a static object from the optimizer, which would
+					// otherwise warn about the operator delete call on it (-Wfree-nonheap-object).
+					void* frame = _frames[i];
+					__asm__("" : "+r"(frame));
+					return frame;
+				}
+			}
+			return nullptr;
+		}
+
+		static void operator delete(void* frame) noexcept
+		{
+			for (uint8_t i = 0; i < BUTTON_TASK_POOL_SIZE; i++)
+			{
+				if (frame == _frames[i]) _frameUsed[i] = false;
+			}
+		}
+	};
+
+	/**
+	 * Returns true if the coroutine got a frame from the pool and was started.
+	 */
+	bool started() const { return _started; }
+
+	/**
+	 * Returns the largest frame requested by a coroutine so far, including the frames that
+	 * did not fit. When started() is false while this is above BUTTON_TASK_FRAME_SIZE, the
+	 * frame size must be raised to at least this value; otherwise the pool was exhausted.
+	 */
+	static size_t frameSizeNeeded() { return _frameSizeNeeded; }
+
+private:
+	explicit ButtonTask(bool started) : _started(started) {}
+
+	bool _started;
+
+	alignas(max_align_t) static inline uint8_t _frames[BUTTON_TASK_POOL_SIZE][BUTTON_TASK_FRAME_SIZE];
+	static inline bool _frameUsed[BUTTON_TASK_POOL_SIZE] = {};
+	static inline size_t _frameSizeNeeded = 0;
+};
+
+/**
+ * This static-only template class provides awaitables for the events of a Buttons class, e.g.:
+ *
+ *   using buttonsAwait = ButtonsAwait<buttons>;
+ *   ButtonTask menu()
+ *   {
+ *     co_await buttonsAwait::pressed(Button1);
+ *     ButtonEventInfo e = co_await buttonsAwait::anyEvent(5000);
+ *     ...
+ *   }
+ *
+ * Suspended coroutines are kept in an intrusive list whose nodes live inside the awaitables
+ * themselves, so waiting allocates nothing. dispatch() must be called from loop(); it only
+ * tests the Buttons event indication (and the nearest timeout, if any), so the number of
+ * suspended waiters costs nothing until an event actually happens.
+ * Flags consumed by a waiter are cleared, just like calling clicked() etc. directly.
+ */
+template <class ButtonsT>
+class ButtonsAwait final
+{
+public:
+	class Awaiter final
+	{
+	public:
+		Awaiter(const Awaiter&) = delete;
+		Awaiter& operator=(const Awaiter&) = delete;
+
+		// If the event is already pending there is no need to suspend.
+		bool await_ready() noexcept { return poll(); }
+
+		void await_suspend(std::coroutine_handle<> handle) noexcept
+		{
+			_handle = handle;
+			link();
+		}
+
+		ButtonEventInfo await_resume() const noexcept { return _result; }
+
+	private:
+		friend class ButtonsAwait;
+
+		Awaiter(uint16_t buttonId, uint8_t eventMask, uint32_t timeout) :
+			_buttonId(buttonId),
+			_eventMask(eventMask),
+			_timed(timeout != 0),
+			_deadline(millis() + timeout),
+			_result{ ButtonEventInfo::NO_BUTTON, ButtonEvent::None, 0, 0, 0 },
+			_next(nullptr)
+		{
+		}
+
+		/**
+		 * Consumes the first pending event that matches this waiter, if any.
+		 */
+		bool poll() noexcept
+		{
+			if (_buttonId != ButtonEventInfo::NO_BUTTON) return pollButton(_buttonId);
+			for (uint16_t i = 0; i < ButtonsT::numberOfButtons(); i++)
+			{
+				if (pollButton(i)) return true;
+			}
+			return false;
+		}
+
+		bool pollButton(uint16_t buttonId) noexcept
+		{
+			// Encoders (classes with read()) report their detents on button 0.
+			if constexpr (requires { ButtonsT::read(); })
+			{
+				if (buttonId == 0 && (_eventMask & maskOf(ButtonEvent::Rotated)))
+				{
+					int16_t steps = ButtonsT::read();
+					if (steps != 0)
+					{
+						_result = { buttonId, ButtonEvent::Rotated, ButtonsT::lastStepTime(), 0, steps };
+						return true;
+					}
+				}
+			}
+
+			// The timestamps are read with the flag, so a press landing meanwhile cannot mix in.
+			ButtonEvent event = ButtonEvent::None;
+			ButtonState::Times times;
+			if ((_eventMask & maskOf(ButtonEvent::DoubleClicked)) && ButtonsT::take(buttonId, ButtonState::DOUBLE_CLICKED_FLAG, times))
+				event = ButtonEvent::DoubleClicked;
+			else if ((_eventMask & maskOf(ButtonEvent::Clicked)) && ButtonsT::take(buttonId, ButtonState::CLICKED_FLAG, times))
+				event = ButtonEvent::Clicked;
+			else if ((_eventMask & maskOf(ButtonEvent::ShortReleased)) && ButtonsT::take(buttonId, ButtonState::SHORT_RELEASED_FLAG, times))
+				event = ButtonEvent::ShortReleased;
+			else if ((_eventMask & maskOf(ButtonEvent::LongReleased)) && ButtonsT::take(buttonId, ButtonState::LONG_RELEASED_FLAG, times))
+				event = ButtonEvent::LongReleased;
+			else
+				return false;
+
+			if (event == ButtonEvent::Clicked || event == ButtonEvent::DoubleClicked)
+				_result = { buttonId, event, times.press, 0, 0 };
+			else
+				_result = { buttonId, event, times.release, times.duration, 0 };
+			return true;
+		}
+
+		bool expired(uint32_t now) const noexcept
+		{
+			if (!_timed || (int32_t)(now - _deadline) < 0) return false;
+			_result = { ButtonEventInfo::NO_BUTTON, ButtonEvent::Timeout, 0, 0, 0 };
+			return true;
+		}
+
+		void link() noexcept
+		{
+			_next = _waiters;
+			_waiters = this;
+			if (_timed)
+			{
+				if (_timedWaiters == 0 || (int32_t)(_deadline - _nextDeadline) < 0)
+					_nextDeadline = _deadline;
+				_timedWaiters++;
+			}
+		}
+
+		uint16_t _buttonId;
+		uint8_t _eventMask;
+		bool _timed;
+		uint32_t _deadline;
+		mutable ButtonEventInfo _result;
+		std::coroutine_handle<> _handle;
+		Awaiter* _next;
+	};
+
+	/**
+	 * Waits for the button to go down, either as a click or as a double click.
+	 */
+	static Awaiter pressed(uint16_t buttonId, uint32_t timeout = 0)
+	{
+		return Awaiter(buttonId, maskOf(ButtonEvent::Clicked) | maskOf(ButtonEvent::DoubleClicked), timeout);
+	}
+
+	/**
+	 * Waits for the button to be released, after either a short or a long press.
+	 */
+	static Awaiter released(uint16_t buttonId, uint32_t timeout = 0)
+	{
+		return Awaiter(buttonId, maskOf(ButtonEvent::ShortReleased) | maskOf(ButtonEvent::LongReleased), timeout);
+	}
+
+	static Awaiter clicked(uint16_t buttonId, uint32_t timeout = 0)
+	{
+		return Awaiter(buttonId, maskOf(ButtonEvent::Clicked), timeout);
+	}
+
+	static Awaiter doubleClicked(uint16_t buttonId, uint32_t timeout = 0)
+	{
+		return Awaiter(buttonId, maskOf(ButtonEvent::DoubleClicked), timeout);
+	}
+
+	static Awaiter shortReleased(uint16_t buttonId, uint32_t timeout = 0)
+	{
+		return Awaiter(buttonId, maskOf(ButtonEvent::ShortReleased), timeout);
+	}
+
+	static Awaiter longReleased(uint16_t buttonId, uint32_t timeout = 0)
+	{
+		return Awaiter(buttonId, maskOf(ButtonEvent::LongReleased), timeout);
+	}
+
+	/**
+	 * Waits for a RotaryEncoder to turn. The detents are taken with read(), so do not mix this
+	 * with direct read() calls.
+	 */
+	static Awaiter rotated(uint32_t timeout = 0)
+	{
+		return Awaiter(0, maskOf(ButtonEvent::Rotated), timeout);
+	}
+
+	/**
+	 * Waits for any event on a single button.
+	 */
+	static Awaiter event(uint16_t buttonId, uint32_t timeout = 0)
+	{
+		return Awaiter(buttonId, ALL_EVENTS, timeout);
+	}
+
+	/**
+	 * Waits for any event on any button.
+	 *
+	 * @param timeout           Milliseconds to wait before resuming with ButtonEvent::Timeout. 0 waits forever.
+	 */
+	static Awaiter anyEvent(uint32_t timeout = 0)
+	{
+		return Awaiter(ButtonEventInfo::NO_BUTTON, ALL_EVENTS, timeout);
+	}
+
+	/**
+	 * Resumes the coroutines whose events happened or whose timeouts expired.
+	 * Must be called from loop(), never from an ISR.
+	 * Timeouts of waiters are not checked until the buttons have been armed.
+	 */
+	static void dispatch()
+	{
+		// Also serves as the tick that arms buttons started with beginAsync().
+		if (!ButtonsT::update()) return;
+
+		const bool pending = ButtonsT::eventPending();
+		const uint32_t now = millis();
+		if (!pending && (_timedWaiters == 0 || (int32_t)(now - _nextDeadline) < 0)) return;
+
+		// Detach the whole list first: resumed coroutines may await again, and those
+		// new waiters must go into a fresh list rather than the one being walked.
+		Awaiter* waiter = _waiters;
+		_waiters = nullptr;
+		_timedWaiters = 0;
+		while (waiter != nullptr)
+		{
+			Awaiter* next = waiter->_next;
+			if ((pending && waiter->poll()) || waiter->expired(now))
+				waiter->_handle.resume();
+			else
+				waiter->link();
+			waiter = next;
+		}
+	}
+
+	//This class has only static members, therefore constructors etc are pointless.
+	ButtonsAwait() = delete;
+	~ButtonsAwait() = delete;
+	ButtonsAwait& operator=(const ButtonsAwait&) = delete;
+	ButtonsAwait(const ButtonsAwait&) = delete;
+
+private:
+	static constexpr uint8_t maskOf(ButtonEvent event) { return _BV(static_cast<uint8_t>(event)); }
+
+	static constexpr uint8_t ALL_EVENTS = maskOf(ButtonEvent::Clicked) | maskOf(ButtonEvent::DoubleClicked) |
+		maskOf(ButtonEvent::ShortReleased) | maskOf(ButtonEvent::LongReleased) | maskOf(ButtonEvent::Rotated);
+
+	static inline Awaiter* _waiters = nullptr;
+	static inline uint8_t _timedWaiters = 0;
+	static inline uint32_t _nextDeadline = 0;
+};
+
+#endif
@@ -0,0 +1,299 @@
+/*
+ *  Arduino Buttons Template Library - Packed input panels
+ *  A polled, bitset-backed class for large numbers of inputs behind expanders or shift registers.
+ *
+ *  Copyright (C) 2017 Vital Holmo Batista
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+#include <buttonsTemplate.h>
+
+/**
+* Word used to pack the inputs: the native register width of the core.
+* Minimum time between two scans that are compared for debouncing, in milliseconds.
+* Can be overridden in user files by #defining them before including this file.
+*/
+#ifndef BUTTONS_WORD_TYPE
+#if defined(__AVR__)
+#define BUTTONS_WORD_TYPE uint8_t
+#else
+#define BUTTONS_WORD_TYPE uint32_t
+#endif
+#endif
+#ifndef PACKED_SCAN_INTERVAL
+#define PACKED_SCAN_INTERVAL (BUTTON_DEBOUNCE_DELAY / 2)
+#endif
+
+/**
+ * This static-only template class manages panels of up to 65535 inputs that are read as a
+ * whole by a user function, e.g. from a chain of shift registers or I/O expanders:
+ *
+ *   void readPanel(BUTTONS_WORD_TYPE inputs[]) { ... set bit i of the array when input i is pressed ... }
+ *   using panel = PackedButtons<400>;
+ *   panel::begin(readPanel);
+ *   ...
+ *   panel::scan();
+ *   for (uint16_t i = panel::nextClicked(); i != panel::NO_BUTTON; i = panel::nextClicked()) ...
+ *
+ * The pressed, clicked and released states are kept as one bit per input, packed in words.
+ * scan() debounces whole words at a time: an input changes once two consecutive readings,
+ * at least PACKED_SCAN_INTERVAL apart, agree on a new level. The events are then extracted
+ * with find-first-set over the event words, resuming from the first word that may still hold
+ * events, so draining them walks the event words once and costs one step per event rather
+ * than a rescan of the panel per event.
+ *
+ * Only press (clicked) and release events are tracked; double click and long release
+ * classification need per-input timestamps and stay with Buttons.
+ * scan() and the accessors must be called from the same context, normally loop().
+ */
+template <const uint16_t NumberOfInputs, class Word = BUTTONS_WORD_TYPE>
+class PackedButtons final
+{
+public:
+	typedef typename ButtonIndexType<(NumberOfInputs > 255)>::type ButtonIndex;
+
+	static constexpr ButtonIndex NO_BUTTON = (ButtonIndex)~0;
+	static constexpr uint8_t WORD_BITS = sizeof(Word) * 8;
+	static constexpr uint16_t WORD_COUNT = (NumberOfInputs + WORD_BITS - 1) / WORD_BITS;
+	static constexpr Word LAST_WORD_MASK = NumberOfInputs % WORD_BITS == 0 ? (Word)~(Word)0 :
+		(Word)(((Word)1 << (NumberOfInputs % WORD_BITS)) - 1);
+
+	/**
+	 * Function that fills WORD_COUNT words with the current inputs, bit set for pressed.
+	 * Input i is bit (i % WORD_BITS) of word (i / WORD_BITS).
+	 */
+	typedef void (*ReadFunction)(Word inputs[]);
+
+	/**
+	 * Captures the current inputs as the initial state.
+	 *
+	 * @param readInputs        Function used by scan() to read the inputs.
+	 * @return                  true on success, false on failure.
+	 */
+	static bool begin(ReadFunction readInputs);
+
+	/**
+	 * Reads the inputs and updates the pressed state and the event words. Calls made sooner
+	 * than PACKED_SCAN_INTERVAL after the previous scan return without reading.
+	 *
+	 * @return                  true if any input changed.
+	 */
+	static bool scan();
+
+	static bool down(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return (_pressed[buttonId / WORD_BITS] & bit(buttonId)) != 0;
+	}
+
+	static bool up(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return !down(buttonId);
+	}
+
+	/**
+	 * Returns true if the input has been pressed since the last call, and clears the event.
+	 */
+	static bool clicked(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return take(_clicked, buttonId);
+	}
+
+	/**
+	 * Returns true if the input has been released since the last call, and clears the event.
+	 */
+	static bool released(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return take(_released, buttonId);
+	}
+
+	/**
+	 * Returns the lowest input with a pending press event and clears that event,
+	 * or NO_BUTTON if there is none.
+	 */
+	static ButtonIndex nextClicked()
+	{
+		return takeNext(_clicked, _firstClickedWord);
+	}
+
+	/**
+	 * Returns the lowest input with a pending release event and clears that event,
+	 * or NO_BUTTON if there is none.
+	 */
+	static ButtonIndex nextReleased()
+	{
+		return takeNext(_released, _firstReleasedWord);
+	}
+
+	static uint16_t numberOfButtons() __attribute__((always_inline))
+	{
+		return NumberOfInputs;
+	}
+
+	/**
+	 * Returns true if scan() has raised any event since the last call, and clears that indication.
+	 */
+	static bool eventPending() __attribute__((always_inline))
+	{
+		bool pending = _eventPending;
+		_eventPending = false;
+		return pending;
+	}
+
+	//This class has only static members, therefore constructors etc are pointless.
+	PackedButtons() = delete;
+	~PackedButtons() = delete;
+	PackedButtons& operator=(const PackedButtons&) = delete;
+	PackedButtons(const PackedButtons&) = delete;
+
+private:
+	static Word bit(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return (Word)1 << (buttonId % WORD_BITS);
+	}
+
+	static bool take(Word events[], ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		Word& word = events[buttonId / WORD_BITS];
+		bool set = (word & bit(buttonId)) != 0;
+		word &= ~bit(buttonId);
+		return set;
+	}
+
+	static ButtonIndex takeNext(Word events[], uint16_t& firstWord);
+
+	static ReadFunction _readInputs;
+	static uint32_t _lastScanTime;
+	static bool _eventPending;
+
+	/**
+	* Packed states, one bit per input. _lastRead holds the previous raw reading for debouncing.
+	*/
+	static Word _pressed[WORD_COUNT];
+	static Word _lastRead[WORD_COUNT];
+	static Word _clicked[WORD_COUNT];
+	static Word _released[WORD_COUNT];
+
+	/**
+	* Lowest word of _clicked and _released that may hold an event, WORD_COUNT if none.
+	*/
+	static uint16_t _firstClickedWord;
+	static uint16_t _firstReleasedWord;
+};
+
+template <uint16_t NumberOfInputs, class Word>
+typename PackedButtons<NumberOfInputs, Word>::ReadFunction PackedButtons<NumberOfInputs, Word>::_readInputs = nullptr;
+
+template <uint16_t NumberOfInputs, class Word>
+uint32_t PackedButtons<NumberOfInputs, Word>::_lastScanTime = 0;
+
+template <uint16_t NumberOfInputs, class Word>
+bool PackedButtons<NumberOfInputs, Word>::_eventPending = false;
+
+template <uint16_t NumberOfInputs, class Word>
+Word PackedButtons<NumberOfInputs, Word>::_pressed[WORD_COUNT];
+
+template <uint16_t NumberOfInputs, class Word>
+Word PackedButtons<NumberOfInputs, Word>::_lastRead[WORD_COUNT];
+
+template <uint16_t NumberOfInputs, class Word>
+Word PackedButtons<NumberOfInputs, Word>::_clicked[WORD_COUNT];
+
+template <uint16_t NumberOfInputs, class Word>
+Word PackedButtons<NumberOfInputs, Word>::_released[WORD_COUNT];
+
+template <uint16_t NumberOfInputs, class Word>
+uint16_t PackedButtons<NumberOfInputs, Word>::_firstClickedWord = WORD_COUNT;
+
+template <uint16_t NumberOfInputs, class Word>
+uint16_t PackedButtons<NumberOfInputs, Word>::_firstReleasedWord = WORD_COUNT;
+
+template <uint16_t NumberOfInputs, class Word>
+bool PackedButtons<NumberOfInputs, Word>::begin(ReadFunction readInputs)
+{
+	// Abort if there is no way to read the inputs
+	if (nullptr == readInputs) return false;
+
+	_readInputs = readInputs;
+	_readInputs(_pressed);
+	_pressed[WORD_COUNT - 1] &= LAST_WORD_MASK;
+	for (uint16_t w = 0; w < WORD_COUNT; w++)
+	{
+		_lastRead[w] = _pressed[w];
+		_clicked[w] = 0;
+		_released[w] = 0;
+	}
+	_firstClickedWord = WORD_COUNT;
+	_firstReleasedWord = WORD_COUNT;
+	_eventPending = false;
+	_lastScanTime = millis();
+	return true;
+}
+
+template <uint16_t NumberOfInputs, class Word>
+bool PackedButtons<NumberOfInputs, Word>::scan()
+{
+	uint32_t now = millis();
+	if (nullptr == _readInputs || now - _lastScanTime < PACKED_SCAN_INTERVAL) return false;
+	_lastScanTime = now;
+
+	Word inputs[WORD_COUNT];
+	_readInputs(inputs);
+	// Bits past the last input are whatever the reader left there.
+	inputs[WORD_COUNT - 1] &= LAST_WORD_MASK;
+
+	bool anyChange = false;
+	for (uint16_t w = 0; w < WORD_COUNT; w++)
+	{
+		// Bits that differ from the debounced state and read the same as in the previous scan.
+		Word changed = (inputs[w] ^ _pressed[w]) & ~(inputs[w] ^ _lastRead[w]);
+		_lastRead[w] = inputs[w];
+		if (changed == 0) continue;
+
+		_pressed[w] ^= changed;
+		if (changed & inputs[w])
+		{
+			_clicked[w] |= changed & inputs[w];
+			if (w < _firstClickedWord) _firstClickedWord = w;
+		}
+		if (changed & ~inputs[w])
+		{
+			_released[w] |= changed & ~inputs[w];
+			if (w < _firstReleasedWord) _firstReleasedWord = w;
+		}
+		anyChange = true;
+	}
+
+	if (anyChange) _eventPending = true;
+	return anyChange;
+}
+
+template <uint16_t NumberOfInputs, class Word>
+typename PackedButtons<NumberOfInputs, Word>::ButtonIndex PackedButtons<NumberOfInputs, Word>::takeNext(Word events[], uint16_t& firstWord)
+{
+	// Words below firstWord are empty, and stay so until scan() lowers it again.
+	for (; firstWord < WORD_COUNT; firstWord++)
+	{
+		Word& word = events[firstWord];
+		if (word == 0) continue;
+
+		uint8_t b = buttonsLowestBit(word);
+		word &= word - 1;
+		return firstWord * WORD_BITS + b;
+	}
+	return NO_BUTTON;
+}
@@ -0,0 +1,301 @@
+/*
+ *  Arduino Buttons Template Library - Pin change interrupt backend
+ *  Interrupt-driven buttons on any pin of the AVR, using the port-level pin change interrupts.
+ *
+ *  Copyright (C) 2017 Vital Holmo Batista
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+#include <buttonsTemplate.h>
+
+// Needs the compile-time port map of ButtonPin, where each port is also one pin change group.
+#if BUTTONS_CONSTEXPR_PORTS
+
+typedef void (*ButtonsPcintHandler)();
+
+/**
+* Handlers run by each pin change vector, indexed like the ButtonPin ports (0 = PORTD, 1 = PORTB, 2 = PORTC).
+* Set by PcintButtons::begin(); a port can only be owned by one PcintButtons class at a time.
+* A function-local static, so that the table has a single definition whichever translation
+* units include this header.
+*/
+inline ButtonsPcintHandler volatile* buttonsPcintHandlers()
+{
+	static ButtonsPcintHandler volatile handlers[BUTTONS_PORT_COUNT];
+	return handlers;
+}
+
+/**
+* Runs the handler of a port. Called by the pin change vectors, or by the application's own
+* vectors when BUTTONS_PCINT_NO_VECTORS is defined (e.g. to share them with SoftwareSerial).
+*/
+inline void buttonsPcintDispatch(uint8_t port)
+{
+	ButtonsPcintHandler handler = buttonsPcintHandlers()[port];
+	if (handler != nullptr) handler();
+}
+
+/**
+ * This static-only template class works like StaticButtons, but uses the pin change interrupts
+ * instead of attachInterrupt(), so any pin can be used, not only the INT0/INT1 pins:
+ *
+ *   using buttons = PcintButtons<4, 5, A0>;
+ *   buttons::begin();
+ *
+ * The pin change interrupt of a port fires for any of its pins. The handler XORs the new port
+ * value with the previous snapshot, masks it with the button pins of that port, and runs the
+ * classification only for the bits that actually changed, so its cost follows the number of
+ * changed buttons. Pin change interrupts also wake the AVR from SLEEP_MODE_PWR_DOWN, so
+ * BUTTONS_SLEEP_MODE can be set to it when only PcintButtons are used.
+ *
+ * This header defines the PCINT vectors: without BUTTONS_PCINT_NO_VECTORS, include it from
+ * one translation unit only. Elsewhere, or to call buttonsPcintDispatch() from your own
+ * vectors, #define BUTTONS_PCINT_NO_VECTORS before including it.
+ */
+template <uint8_t... Pins>
+class PcintButtons final : public ButtonsBase<PcintButtons<Pins...>, sizeof...(Pins), ButtonState>
+{
+	using Base = ButtonsBase<PcintButtons<Pins...>, sizeof...(Pins), ButtonState>;
+
+	static_assert(ButtonPinList<Pins...>::allMapped(), "Every pin must be on PORTB, PORTC or PORTD");
+
+public:
+
+	/**
+	 * Initialize the buttons and enable the pin change interrupts of their pins.
+	 *
+	 * @return                  true on success, false on failure.
+	 */
+	static bool begin();
+
+	/**
+	 * Same as begin(), but does not wait for the pull-ups to settle: the interrupts are
+	 * enabled by the first update() call made at least BUTTON_SETTLE_DELAY milliseconds later.
+	 *
+	 * @return                  true on success, false on failure.
+	 */
+	static bool beginAsync();
+
+	/**
+	 * Disable the pin change interrupts of the pins controlled by this object.
+	 * If the object has not been started with begin(), calling this will do nothing.
+	 */
+	static void stop();
+
+	static bool polledDown(uint8_t buttonId)
+	{
+		return (readPort(_ports[buttonId]) & _masks[buttonId]) == 0;
+	}
+
+	static uint8_t pin(uint8_t buttonId)
+	{
+		static const uint8_t pins[] = { Pins... };
+		return pins[buttonId];
+	}
+
+	//This class has only static members, therefore constructors etc are pointless.
+	PcintButtons() = delete;
+	~PcintButtons() = delete;
+	PcintButtons& operator=(const PcintButtons&) = delete;
+	PcintButtons(const PcintButtons&) = delete;
+
+private:
+	friend Base;
+
+	/**
+	* Mask of the button pins on a port.
+	*/
+	static constexpr uint8_t portMask(uint8_t port)
+	{
+		return ButtonPinList<Pins...>::portMask(port);
+	}
+
+	static uint8_t readPort(uint8_t port) __attribute__((always_inline))
+	{
+		return port == 0 ? PIND : (port == 1 ? PINB : PINC);
+	}
+
+	/**
+	* Enables the pin change interrupts and captures the initial state of the buttons.
+	*/
+	static void arm();
+
+	/**
+	* Pin change handler of one port.
+	*/
+	template <uint8_t Port>
+	static void port_ISR();
+
+	/**
+	* Port and mask of each button, and the button index of each bit of each port.
+	*/
+	static const uint8_t _ports[sizeof...(Pins)];
+	static const uint8_t _masks[sizeof...(Pins)];
+	static uint8_t _buttonOfBit[BUTTONS_PORT_COUNT][8];
+
+	/**
+	* Port values seen by the last pin change interrupt.
+	*/
+	static volatile uint8_t _snapshots[BUTTONS_PORT_COUNT];
+};
+
+template <uint8_t... Pins>
+const uint8_t PcintButtons<Pins...>::_ports[sizeof...(Pins)] = { ButtonPin<Pins>::port... };
+
+template <uint8_t... Pins>
+const uint8_t PcintButtons<Pins...>::_masks[sizeof...(Pins)] = { ButtonPin<Pins>::mask... };
+
+template <uint8_t... Pins>
+uint8_t PcintButtons<Pins...>::_buttonOfBit[BUTTONS_PORT_COUNT][8];
+
+template <uint8_t... Pins>
+volatile uint8_t PcintButtons<Pins...>::_snapshots[BUTTONS_PORT_COUNT];
+
+template <uint8_t... Pins>
+bool PcintButtons<Pins...>::begin()
+{
+	beginAsync();
+
+	// Need to wait some time before setting up the ISRs, otherwise you can get spurious
+	// changes as the pullup hasn't quite done its magic yet.
+	delay(BUTTON_SETTLE_DELAY);
+	arm();
+	return true;
+}
+
+template <uint8_t... Pins>
+bool PcintButtons<Pins...>::beginAsync()
+{
+	// If the buttons have already been started, kill them before restarting.
+	stop();
+
+	int pins[] = { 0, (pinMode(Pins, INPUT_PULLUP), 0)... };
+	(void)pins;
+
+	uint8_t i = 0;
+	int bits[] = { 0, (_buttonOfBit[ButtonPin<Pins>::port][buttonsLowestBit(ButtonPin<Pins>::mask)] = i++, 0)... };
+	(void)bits;
+
+	Base::startArming();
+	return true;
+}
+
+template <uint8_t... Pins>
+void PcintButtons<Pins...>::arm()
+{
+	ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+	unsigned long now = BUTTONS_NOW();
+	for (uint8_t port = 0; port < BUTTONS_PORT_COUNT; port++)
+		_snapshots[port] = readPort(port);
+	for (uint8_t i = 0; i < sizeof...(Pins); i++)
+		Base::reset(i, (_snapshots[_ports[i]] & _masks[i]) == 0, now);
+
+	// Port 0 is PORTD (PCINT2), port 1 PORTB (PCINT0), port 2 PORTC (PCINT1).
+	if (portMask(0))
+	{
+		buttonsPcintHandlers()[0] = &port_ISR<0>;
+		PCMSK2 |= portMask(0);
+		PCIFR = _BV(PCIF2);
+		PCICR |= _BV(PCIE2);
+	}
+	if (portMask(1))
+	{
+		buttonsPcintHandlers()[1] = &port_ISR<1>;
+		PCMSK0 |= portMask(1);
+		PCIFR = _BV(PCIF0);
+		PCICR |= _BV(PCIE0);
+	}
+	if (portMask(2))
+	{
+		buttonsPcintHandlers()[2] = &port_ISR<2>;
+		PCMSK1 |= portMask(2);
+		PCIFR = _BV(PCIF1);
+		PCICR |= _BV(PCIE1);
+	}
+	buttonsRestoreInterrupts(interruptState);
+
+	Base::armed();
+}
+
+template <uint8_t... Pins>
+void PcintButtons<Pins...>::stop()
+{
+	// A start still waiting for the pull-ups to settle has no interrupts to disable,
+	// and if the object is already stopped, we don't need to do anything.
+	if (!Base::stopping())
+		return;
+
+	// The group interrupt itself is left enabled if other pins of the port still use it.
+	ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+	if (portMask(0))
+	{
+		PCMSK2 &= ~portMask(0);
+		if (PCMSK2 == 0) PCICR &= ~_BV(PCIE2);
+		buttonsPcintHandlers()[0] = nullptr;
+	}
+	if (portMask(1))
+	{
+		PCMSK0 &= ~portMask(1);
+		if (PCMSK0 == 0) PCICR &= ~_BV(PCIE0);
+		buttonsPcintHandlers()[1] = nullptr;
+	}
+	if (portMask(2))
+	{
+		PCMSK1 &= ~portMask(2);
+		if (PCMSK1 == 0) PCICR &= ~_BV(PCIE1);
+		buttonsPcintHandlers()[2] = nullptr;
+	}
+	buttonsRestoreInterrupts(interruptState);
+}
+
+template <uint8_t... Pins>
+template <uint8_t Port>
+void PcintButtons<Pins...>::port_ISR()
+{
+	uint8_t value = readPort(Port);
+	uint8_t changed = (value ^ _snapshots[Port]) & portMask(Port);
+	_snapshots[Port] = value;
+	if (changed == 0) return;
+
+	unsigned long now = BUTTONS_NOW();
+	do
+	{
+		uint8_t bit = buttonsLowestBit(changed);
+		changed &= changed - 1;
+		Base::updateButton(_buttonOfBit[Port][bit], (value & _BV(bit)) == 0, now);
+	} while (changed != 0);
+}
+
+#ifndef BUTTONS_PCINT_NO_VECTORS
+ISR(PCINT0_vect)
+{
+	buttonsPcintDispatch(1);
+}
+
+ISR(PCINT1_vect)
+{
+	buttonsPcintDispatch(2);
+}
+
+ISR(PCINT2_vect)
+{
+	buttonsPcintDispatch(0);
+}
+#endif
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ *  Arduino Buttons Template Library - Lock-free event queue
+ *  Delivers the button events in order to a consumer that may run on another core than the ISRs.
+ *
+ *  Copyright (C) 2017 Vital Holmo Batista
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+#include <buttonsTemplate.h>
+
+// Needs compare-and-swap on 32-bit words: on AVR and ARMv6-M (see BUTTONS_ATOMIC_FLAGS) this file is empty.
+#if BUTTONS_ATOMIC_FLAGS
+
+/**
+* Default number of events the queue can hold, must be a power of two.
+* Can be overridden in user files by #defining it before including this file.
+*/
+#ifndef BUTTON_EVENT_QUEUE_SIZE
+#define BUTTON_EVENT_QUEUE_SIZE 16
+#endif
+
+/**
+* An event taken from a ButtonEventQueue.
+*/
+struct ButtonQueuedEvent
+{
+	uint16_t buttonId;
+
+	/**
+	* The flag raised: ButtonState::CLICKED_FLAG, DOUBLE_CLICKED_FLAG, SHORT_RELEASED_FLAG or LONG_RELEASED_FLAG,
+	* or STEP_UP_FLAG or STEP_DOWN_FLAG for a RotaryEncoder detent.
+	*/
+	uint8_t flag;
+
+	/**
+	* Time of the edge, in BUTTONS_NOW() ticks.
+	*/
+	unsigned long time;
+
+	/**
+	* How long the press lasted for SHORT_RELEASED_FLAG and LONG_RELEASED_FLAG, 0 for the other flags,
+	* in BUTTONS_NOW() ticks.
+	*/
+	unsigned long duration;
+};
+
+/**
+ * This static-only template class queues the events of a buttons class as they are raised,
+ * so that another core or thread can consume them without disabling interrupts:
+ *
+ *   using events = ButtonEventQueue<buttons>;
+ *   events::begin();
+ *   ...
+ *   ButtonQueuedEvent e;
+ *   while (events::pop(e)) ...
+ *
+ * It is a bounded multi-producer, single-consumer ring: every slot carries a sequence number
+ * that tells whether it is free for the lap of the producers or holds an event for the
+ * consumer. Producers (the ISRs, on any core) claim a slot with one compare-and-swap and
+ * publish it with a release store; the consumer reads it after an acquire load and hands it
+ * back to the next lap, so each event is delivered exactly once and in order. When the queue
+ * is full, the new event is dropped and counted by dropped().
+ *
+ * The flags behind clicked() etc. are still raised as usual: consume the events either
+ * through the queue or through the accessors, not both.
+ */
+template <class ButtonsT, const uint16_t Capacity = BUTTON_EVENT_QUEUE_SIZE>
+class ButtonEventQueue final
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "The capacity must be a power of two");
+
+public:
+	/**
+	 * Empties the queue and installs post() as the event handler of ButtonsT.
+	 */
+	static void begin()
+	{
+		ButtonsT::setEventHandler(nullptr);
+		for (uint16_t i = 0; i < Capacity; i++)
+			__atomic_store_n(&_slots[i].sequence, i, __ATOMIC_RELAXED);
+		__atomic_store_n(&_tail, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&_dropped, 0, __ATOMIC_RELAXED);
+		_head = 0;
+		ButtonsT::setEventHandler(&post);
+	}
+
+	/**
+	 * Removes the event handler of ButtonsT. Events already queued can still be popped.
+	 */
+	static void stop()
+	{
+		ButtonsT::setEventHandler(nullptr);
+	}
+
+	/**
+	 * Adds an event. Installed as the event handler by begin(), but can also be called
+	 * directly, from any core.
+	 */
+	static void post(uint16_t buttonId, uint8_t flag, unsigned long time, unsigned long duration);
+
+	/**
+	 * Takes the oldest event. Must always be called from the same core or thread.
+	 *
+	 * @param event             Receives the event.
+	 * @return                  false if the queue is empty.
+	 */
+	static bool pop(ButtonQueuedEvent& event);
+
+	/**
+	 * Returns the number of events dropped because the queue was full since begin().
+	 */
+	static uint32_t dropped()
+	{
+		return __atomic_load_n(&_dropped, __ATOMIC_RELAXED);
+	}
+
+	//This class has only static members, therefore constructors etc are pointless.
+	ButtonEventQueue() = delete;
+	~ButtonEventQueue() = delete;
+	ButtonEventQueue& operator=(const ButtonEventQueue&) = delete;
+	ButtonEventQueue(const ButtonEventQueue&) = delete;
+
+private:
+	struct Slot
+	{
+		/**
+		* Equal to the position of the slot when it is free for that position,
+		* to the position + 1 once the event written there has been published.
+		*/
+		uint32_t sequence;
+		ButtonQueuedEvent event;
+	};
+
+	static Slot _slots[Capacity];
+
+	/**
+	* Next position to claim by the producers, and next position to read by the consumer.
+	*/
+	static uint32_t _tail;
+	static uint32_t _head;
+
+	static uint32_t _dropped;
+};
+
+template <class ButtonsT, uint16_t Capacity>
+typename ButtonEventQueue<ButtonsT, Capacity>::Slot ButtonEventQueue<ButtonsT, Capacity>::_slots[Capacity];
+
+template <class ButtonsT, uint16_t Capacity>
+uint32_t ButtonEventQueue<ButtonsT, Capacity>::_tail = 0;
+
+template <class ButtonsT, uint16_t Capacity>
+uint32_t ButtonEventQueue<ButtonsT, Capacity>::_head = 0;
+
+template <class ButtonsT, uint16_t Capacity>
+uint32_t ButtonEventQueue<ButtonsT, Capacity>::_dropped = 0;
+
+template <class ButtonsT, uint16_t Capacity>
+void ButtonEventQueue<ButtonsT, Capacity>::post(uint16_t buttonId, uint8_t flag, unsigned long time, unsigned long duration)
+{
+	uint32_t position = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+	Slot* slot;
+	for (;;)
+	{
+		slot = &_slots[position & (Capacity - 1)];
+		int32_t lap = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - position);
+		if (lap == 0)
+		{
+			// The slot is free for this position: claim it, or retry with the position another producer left.
+			if (__atomic_compare_exchange_n(&_tail, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		}
+		else if (lap < 0)
+		{
+			// The slot still holds the event of the previous lap: the queue is full.
+			__atomic_fetch_add(&_dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		else
+		{
+			position = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->event.buttonId = buttonId;
+	slot->event.flag = flag;
+	slot->event.time = time;
+	slot->event.duration = duration;
+	__atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+template <class ButtonsT, uint16_t Capacity>
+bool ButtonEventQueue<ButtonsT, Capacity>::pop(ButtonQueuedEvent& event)
+{
+	Slot& slot = _slots[_head & (Capacity - 1)];
+	if (__atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE) != _head + 1) return false;
+
+	event = slot.event;
+	// Hand the slot back to the producers for the next lap.
+	__atomic_store_n(&slot.sequence, _head + Capacity, __ATOMIC_RELEASE);
+	_head++;
+	return true;
+}
+
+#endif
@@ -38,42 +38,1159 @@
 #ifndef LONG_RELEASE_DELAY
 #define LONG_RELEASE_DELAY 1000
 #endif
+#ifndef BUTTON_SETTLE_DELAY
+#define BUTTON_SETTLE_DELAY 10
+#endif
 
 /**
-* This structure encompasses information relating to an individual button.
+* Clock used to timestamp the button edges. #define BUTTONS_MICROS to timestamp with micros()
+* instead of millis(); timestamps and durations are then in microseconds (note that micros()
+* wraps around after about 71 minutes, so durations must be shorter than that).
+*/
+#ifdef BUTTONS_MICROS
+#define BUTTONS_NOW() micros()
+#define BUTTONS_TICKS_PER_MS 1000UL
+#else
+#define BUTTONS_NOW() millis()
+#define BUTTONS_TICKS_PER_MS 1UL
+#endif
+
+/**
+* Puts the core to sleep until the next interrupt. Called by sleepUntilEvent() with interrupts
+* disabled, and must return with interrupts disabled, after letting the interrupt that woke the
+* core run (otherwise the event that ends the sleep is never raised). The defaults keep the peripheral clocks
+* running so that the CHANGE interrupts on the button pins can wake the core. Override it
+* (e.g. with a STOP mode entry that restores the clocks on wake) for deeper sleep modes.
+*/
+#ifndef BUTTONS_ENTER_SLEEP
+#if defined(__AVR__)
+#include <avr/sleep.h>
+#ifndef BUTTONS_SLEEP_MODE
+#define BUTTONS_SLEEP_MODE SLEEP_MODE_IDLE
+#endif
+#define BUTTONS_ENTER_SLEEP() do { set_sleep_mode(BUTTONS_SLEEP_MODE); sleep_enable(); sei(); sleep_cpu(); sleep_disable(); cli(); } while (0)
+#elif defined(__arm__)
+// WFI wakes on a pending interrupt even while PRIMASK masks it; the window then lets it run.
+#define BUTTONS_ENTER_SLEEP() do { __WFI(); interrupts(); noInterrupts(); } while (0)
+#else
+#define BUTTONS_ENTER_SLEEP() do { interrupts(); noInterrupts(); } while (0)
+#endif
+#endif
+
+/**
+* Disables the interrupts and returns their previous state, to be given back to
+* buttonsRestoreInterrupts(). Unlike noInterrupts()/interrupts() pairs, these nest: the
+* accessors can be called from the ISRs and event handlers, or inside the application's own
+* critical sections, without enabling the interrupts on return. The state is SREG on AVR and
+* PRIMASK on ARM. Other cores can provide theirs by #defining BUTTONS_SAVE_INTERRUPTS() and
+* BUTTONS_RESTORE_INTERRUPTS(state) before including this file; without them the interrupts
+* are enabled again on restore.
+*/
+#if defined(__AVR__)
+typedef uint8_t ButtonsInterruptState;
+#else
+typedef uint32_t ButtonsInterruptState;
+#endif
+
+inline ButtonsInterruptState buttonsDisableInterrupts() __attribute__((always_inline));
+
+inline ButtonsInterruptState buttonsDisableInterrupts()
+{
+#if defined(BUTTONS_SAVE_INTERRUPTS)
+	return BUTTONS_SAVE_INTERRUPTS();
+#elif defined(__AVR__)
+	ButtonsInterruptState state = SREG;
+	cli();
+	return state;
+#elif defined(__arm__)
+	ButtonsInterruptState state = __get_PRIMASK();
+	__disable_irq();
+	return state;
+#else
+	noInterrupts();
+	return 0;
+#endif
+}
+
+inline void buttonsRestoreInterrupts(ButtonsInterruptState state) __attribute__((always_inline));
+
+inline void buttonsRestoreInterrupts(ButtonsInterruptState state)
+{
+#if defined(BUTTONS_RESTORE_INTERRUPTS)
+	BUTTONS_RESTORE_INTERRUPTS(state);
+#elif defined(__AVR__)
+	SREG = state;
+#elif defined(__arm__)
+	__set_PRIMASK(state);
+#else
+	(void)state;
+	interrupts();
+#endif
+}
+
+/**
+* Returns the index of the lowest set bit of a non-zero word.
+*/
+template <class Word>
+inline uint8_t buttonsLowestBit(Word word) __attribute__((always_inline));
+
+template <class Word>
+inline uint8_t buttonsLowestBit(Word word)
+{
+	return sizeof(Word) <= sizeof(unsigned int) ? __builtin_ctz(word) :
+		(sizeof(Word) <= sizeof(unsigned long) ? __builtin_ctzl(word) : __builtin_ctzll(word));
+}
+
+/**
+* Set when the ISRs may run on another core than loop(), so the event flags shared between them
+* are updated with atomic operations instead of plain volatile read-modify-writes. Releases order
+* the timestamps and flags written by the ISR before the flag or indication that announces them;
+* acquires order them after it for the consumer.
+* Cleared on AVR and ARMv6-M (Cortex-M0/M0+: SAMD21, STM32F0...), which have no atomic
+* instructions (the __atomic builtins would need library calls that are not linked in); there
+* the flags are updated with interrupts disabled, which is enough on a single core. Dual-core
+* ARMv6-M parts (RP2040) that run the button ISRs on the other core must #define it to 1 and
+* link an implementation of the __atomic library calls.
 */
-struct Button
+#ifndef BUTTONS_ATOMIC_FLAGS
+#if defined(__AVR__) || defined(__ARM_ARCH_6M__)
+#define BUTTONS_ATOMIC_FLAGS 0
+#else
+#define BUTTONS_ATOMIC_FLAGS 1
+#endif
+#endif
+
+/**
+* Raises the "event pending" indication of a buttons class from its ISR.
+*/
+inline void buttonsRaisePending(volatile bool& pending) __attribute__((always_inline));
+
+inline void buttonsRaisePending(volatile bool& pending)
+{
+#if BUTTONS_ATOMIC_FLAGS
+	__atomic_store_n(&pending, true, __ATOMIC_RELEASE);
+#else
+	pending = true;
+#endif
+}
+
+/**
+* Returns the "event pending" indication of a buttons class and clears it.
+*/
+inline bool buttonsTakePending(volatile bool& pending) __attribute__((always_inline));
+
+inline bool buttonsTakePending(volatile bool& pending)
+{
+#if BUTTONS_ATOMIC_FLAGS
+	return __atomic_exchange_n(&pending, false, __ATOMIC_ACQ_REL);
+#else
+	if (!pending) return false;
+	pending = false;
+	return true;
+#endif
+}
+
+/**
+* Debounce, double click and long release periods, in BUTTONS_NOW() ticks.
+*/
+struct ButtonTimings
 {
+	unsigned long debounce, doubleClick, longRelease;
+
+	constexpr ButtonTimings() :
+		debounce(BUTTON_DEBOUNCE_DELAY * BUTTONS_TICKS_PER_MS),
+		doubleClick(DOUBLE_CLICK_DELAY * BUTTONS_TICKS_PER_MS),
+		longRelease(LONG_RELEASE_DELAY * BUTTONS_TICKS_PER_MS)
+	{
+	}
+
 	/**
-	* Stores pin number of the button.
+	* Changes one of the periods, given in milliseconds, with interrupts disabled so that
+	* the ISR never classifies an edge with a half written value.
 	*/
-	uint8_t pin;
+	static void set(unsigned long& timing, unsigned long ms)
+	{
+		ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+		timing = ms * BUTTONS_TICKS_PER_MS;
+		buttonsRestoreInterrupts(interruptState);
+	}
+
+	/**
+	* Converts BUTTONS_NOW() ticks to milliseconds, rounding up.
+	*/
+	static uint32_t roundUpToMs(unsigned long ticks)
+	{
+		return (ticks + BUTTONS_TICKS_PER_MS - 1) / BUTTONS_TICKS_PER_MS;
+	}
+};
+
+/**
+* Start-up state of a buttons class: the pins are configured first, and the interrupts are
+* attached once the pull-ups have had BUTTON_SETTLE_DELAY milliseconds to settle.
+*/
+struct ButtonsStart
+{
+	/**
+	* Set once the interrupts are attached, and between beginAsync() and the arming.
+	*/
+	bool begun, arming;
+
+	/**
+	* Time after which the interrupts may be attached.
+	*/
+	uint32_t deadline;
+
+	constexpr ButtonsStart() :
+		begun(false),
+		arming(false),
+		deadline(0)
+	{
+	}
+
+	/**
+	* Marks the pins as configured, to be armed once BUTTON_SETTLE_DELAY has elapsed.
+	*/
+	void configured()
+	{
+		deadline = millis() + BUTTON_SETTLE_DELAY;
+		arming = true;
+	}
+
+	/**
+	* Returns true if the pins are configured and have settled, so the interrupts may be attached.
+	*/
+	bool due() const
+	{
+		return arming && (int32_t)(millis() - deadline) >= 0;
+	}
+
+	/**
+	* Records that the interrupts are attached and the buttons are running.
+	*/
+	void armed()
+	{
+		arming = false;
+		begun = true;
+	}
+
+	/**
+	* Cancels a start still waiting for the pull-ups to settle, and marks the buttons as stopped.
+	* Returns true if the interrupts were attached, so the caller has to detach them.
+	*/
+	bool stop()
+	{
+		bool wasBegun = begun;
+		arming = false;
+		begun = false;
+		return wasBegun;
+	}
+};
+
+/**
+* Layout of the binary configuration blob written by saveConfig() and read by loadConfig(),
+* meant to be kept in EEPROM or flash so that units can be retuned without reflashing.
+* All fields are little endian:
+*
+*   offset 0   'B', 'T'            magic
+*   offset 2   version             ButtonsConfig::VERSION
+*   offset 3   button count        uint16_t
+*   offset 5   debounce            uint16_t, milliseconds
+*   offset 7   double click        uint16_t, milliseconds
+*   offset 9   long release        uint16_t, milliseconds
+*   offset 11  pins                one uint8_t per button
+*   last 2     CRC-16/CCITT        uint16_t, over all the previous bytes
+*/
+struct ButtonsConfig
+{
+	static constexpr uint8_t VERSION = 1;
+	static constexpr uint16_t HEADER_SIZE = 11;
+
+	/**
+	* Size in bytes of the blob of a class with pinCount buttons.
+	*/
+	static constexpr uint16_t size(uint16_t pinCount)
+	{
+		return HEADER_SIZE + pinCount + 2;
+	}
+
+	/**
+	* Returns the pin map stored in a valid blob.
+	*/
+	static const uint8_t* pins(const uint8_t config[])
+	{
+		return config + HEADER_SIZE;
+	}
+
+	/**
+	* Returns true if the blob has the right magic, version, button count, size and CRC.
+	*/
+	static bool valid(const uint8_t config[], uint16_t configSize, uint16_t pinCount)
+	{
+		if (nullptr == config || configSize < size(pinCount)) return false;
+		if (config[0] != 'B' || config[1] != 'T' || config[2] != VERSION || read16(config + 3) != pinCount) return false;
+		return read16(config + HEADER_SIZE + pinCount) == crc16(config, HEADER_SIZE + pinCount);
+	}
+
+	static uint16_t read16(const uint8_t data[])
+	{
+		return data[0] | (uint16_t)data[1] << 8;
+	}
+
+	static void write16(uint8_t data[], uint16_t value)
+	{
+		data[0] = value & 0xFF;
+		data[1] = value >> 8;
+	}
+
+	/**
+	* Longest period the blob can store, in milliseconds.
+	*/
+	static constexpr unsigned long MAX_PERIOD = 0xFFFF;
+
+	/**
+	* Writes the header of a blob with pinCount buttons and the given periods. The caller then
+	* fills in the pins and calls seal(). Returns false if the buffer is too small, or if a
+	* period is longer than MAX_PERIOD (it would be stored truncated).
+	*/
+	static bool writeHeader(uint8_t config[], uint16_t configSize, uint16_t pinCount, const ButtonTimings& timings)
+	{
+		if (nullptr == config || configSize < size(pinCount)) return false;
+		if (timings.debounce / BUTTONS_TICKS_PER_MS > MAX_PERIOD || timings.doubleClick / BUTTONS_TICKS_PER_MS > MAX_PERIOD ||
+			timings.longRelease / BUTTONS_TICKS_PER_MS > MAX_PERIOD) return false;
+
+		config[0] = 'B';
+		config[1] = 'T';
+		config[2] = VERSION;
+		write16(config + 3, pinCount);
+		write16(config + 5, timings.debounce / BUTTONS_TICKS_PER_MS);
+		write16(config + 7, timings.doubleClick / BUTTONS_TICKS_PER_MS);
+		write16(config + 9, timings.longRelease / BUTTONS_TICKS_PER_MS);
+		return true;
+	}
+
+	/**
+	* Appends the CRC to a blob whose header and pins are written, and returns its size.
+	*/
+	static uint16_t seal(uint8_t config[], uint16_t pinCount)
+	{
+		write16(config + HEADER_SIZE + pinCount, crc16(config, HEADER_SIZE + pinCount));
+		return size(pinCount);
+	}
+
+	/**
+	* Applies the periods of a valid blob, with interrupts disabled.
+	*/
+	static void apply(const uint8_t config[], ButtonTimings& timings)
+	{
+		ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+		timings.debounce = read16(config + 5) * BUTTONS_TICKS_PER_MS;
+		timings.doubleClick = read16(config + 7) * BUTTONS_TICKS_PER_MS;
+		timings.longRelease = read16(config + 9) * BUTTONS_TICKS_PER_MS;
+		buttonsRestoreInterrupts(interruptState);
+	}
+
+	static uint16_t crc16(const uint8_t data[], uint16_t length)
+	{
+		uint16_t crc = 0xFFFF;
+		while (length--)
+		{
+			crc ^= (uint16_t)*data++ << 8;
+			for (uint8_t bit = 0; bit < 8; bit++)
+				crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+		return crc;
+	}
+};
+
+/**
+* This structure encompasses the debounce and click state of an individual button,
+* and the classification logic run by the ISRs of every buttons class.
+*/
+struct ButtonState
+{
+	static constexpr uint8_t CLEAR_FLAGS = 0;
+	static constexpr uint8_t PRESSED_FLAG = _BV(0);
+	static constexpr uint8_t CLICKED_FLAG = _BV(1);
+	static constexpr uint8_t SHORT_RELEASED_FLAG = _BV(2);
+	static constexpr uint8_t LONG_RELEASED_FLAG = _BV(3);
+	static constexpr uint8_t DOUBLE_CLICKED_FLAG = _BV(4);
+
+	/**
+	* Detents of a RotaryEncoder, A leading B (up) or B leading A (down). Never stored in
+	* state: they are only reported to the event handlers.
+	*/
+	static constexpr uint8_t STEP_UP_FLAG = _BV(5);
+	static constexpr uint8_t STEP_DOWN_FLAG = _BV(6);
 
 	/**
 	* Stores the most recently measured state of the button.
 	*/
 	uint8_t state;
 
+#if BUTTONS_ATOMIC_FLAGS
+	/**
+	* Sequence counter of lastClickTime, lastReleaseTime and the flags: odd while update() is
+	* writing them. The ISR may run on another core, where masking interrupts does not keep it
+	* out, so times() and take() retry until they read the same even count before and after.
+	*/
+	uint16_t sequence;
+#endif
+
 	/**
 	* This records the last time that an Interrupt was triggered from this pin.
 	* Used as part of the debounce routine.
+	* lastClickTime and lastReleaseTime are the debounced press and release times.
+	*/
+	unsigned long lastChangeTime, lastClickTime, lastReleaseTime;
+
+	/**
+	* Constructor for objects of ButtonState.
+	*/
+	ButtonState() :
+		state(0),
+#if BUTTONS_ATOMIC_FLAGS
+		sequence(0),
+#endif
+		lastChangeTime(0),
+		lastClickTime(0),
+		lastReleaseTime(0)
+	{
+	}
+
+	/**
+	* Sets the initial state of the button from a reading taken with its interrupt not yet attached.
+	*/
+	void reset(bool readState, unsigned long now) volatile
+	{
+		state = readState ? PRESSED_FLAG : CLEAR_FLAGS;
+		lastClickTime = now;
+		lastChangeTime = now;
+		lastReleaseTime = now;
+	}
+
+	/**
+	* Returns true if the flag is set, and clears it.
+	*/
+	bool take(uint8_t flag) volatile __attribute__((always_inline))
+	{
+#if BUTTONS_ATOMIC_FLAGS
+		return (__atomic_fetch_and(&state, (uint8_t)~flag, __ATOMIC_ACQ_REL) & flag) != 0;
+#else
+		// The ISR could raise another flag between the read and the write back.
+		ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+		uint8_t set = state & flag;
+		state &= ~flag;
+		buttonsRestoreInterrupts(interruptState);
+		return set != 0;
+#endif
+	}
+
+	/**
+	* Press and release timestamps of a button, and the duration of its last press.
+	*/
+	struct Times
+	{
+		unsigned long press, release, duration;
+	};
+
+	/**
+	* Returns the press and release timestamps and the press duration, read together so that
+	* they all belong to the same press.
 	*/
-	unsigned long lastChangeTime, lastClickTime;
+	Times times(unsigned long now) const volatile
+	{
+		Times result;
+#if BUTTONS_ATOMIC_FLAGS
+		uint16_t count;
+		do
+		{
+			count = beginRead();
+			readTimes(__atomic_load_n(&state, __ATOMIC_ACQUIRE), now, result);
+		} while (retryRead(count));
+#else
+		ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+		readTimes(state, now, result);
+		buttonsRestoreInterrupts(interruptState);
+#endif
+		return result;
+	}
+
+	/**
+	* Same as take(), and if the flag was set, also returns the timestamps of the press it belongs
+	* to, read together with the flag. A later press replaces all the flags, so while the flag is
+	* still set the timestamps cannot belong to a newer press.
+	* With BUTTONS_ATOMIC_FLAGS, must not be called from an interrupt that can preempt the
+	* button's own ISR: it waits for update() to finish writing.
+	*/
+	bool take(uint8_t flag, unsigned long now, Times& times) volatile
+	{
+#if BUTTONS_ATOMIC_FLAGS
+		for (;;)
+		{
+			uint16_t count = beginRead();
+			uint8_t flags = __atomic_load_n(&state, __ATOMIC_ACQUIRE);
+			if ((flags & flag) == 0)
+			{
+				if (retryRead(count)) continue;
+				return false;
+			}
+			readTimes(flags, now, times);
+			if (retryRead(count)) continue;
+			// Fails if the ISR changed the flags since they were read, with the timestamps then
+			// possibly belonging to another press: read everything again.
+			if (__atomic_compare_exchange_n(&state, &flags, (uint8_t)(flags & ~flag),
+				false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+				return true;
+		}
+#else
+		ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+		uint8_t flags = state;
+		state = flags & ~flag;
+		readTimes(flags, now, times);
+		buttonsRestoreInterrupts(interruptState);
+		return (flags & flag) != 0;
+#endif
+	}
+
+	/**
+	* Returns the duration reported to the event handlers with a flag just raised by update():
+	* how long the press lasted for a release flag, 0 for the other flags. Called by the ISR,
+	* the only writer of the timestamps.
+	*/
+	unsigned long eventDuration(uint8_t raised, unsigned long now) const volatile
+	{
+		return (raised & (SHORT_RELEASED_FLAG | LONG_RELEASED_FLAG)) ? now - lastClickTime : 0;
+	}
+
+	/**
+	* Returns how many ticks are left before the debounce window and the double click (released)
+	* or long release (held) window of the button have closed, 0 if they are all closed.
+	* Must be called with interrupts disabled.
+	*/
+	unsigned long ticksUntilIdle(unsigned long now, const ButtonTimings& timings) const volatile
+	{
+		unsigned long remaining = 0;
+		unsigned long sinceChange = now - lastChangeTime;
+		unsigned long sinceClick = now - lastClickTime;
+		if (sinceChange <= timings.debounce)
+			remaining = timings.debounce + 1 - sinceChange;
+		// A held button needs the clock until its release would be classified as long anyway,
+		// a released one until its double click window has closed.
+		unsigned long window = (state & PRESSED_FLAG) ? timings.longRelease : timings.doubleClick;
+		if (sinceClick <= window && window + 1 - sinceClick > remaining)
+			remaining = window + 1 - sinceClick;
+		return remaining;
+	}
+
+	/**
+	* Feeds a new reading of the button into the debounce and click classification.
+	*
+	* @param readState         true if the button was read as down.
+	* @param now               Time of the reading, from BUTTONS_NOW().
+	* @param timings           Periods to classify with.
+	* @return                  The click or release flag raised, CLEAR_FLAGS if none.
+	*/
+	uint8_t update(bool readState, unsigned long now, const ButtonTimings& timings) volatile
+	{
+		if (readState == ((loadFlags() & PRESSED_FLAG) != 0)) return CLEAR_FLAGS;
+
+		uint8_t raised = CLEAR_FLAGS;
+		if (now - lastChangeTime > timings.debounce)
+		{
+			if (readState) // button has been clicked
+			{
+				if (now - lastClickTime > timings.doubleClick)
+				{
+					raised = CLICKED_FLAG;
+				}
+				else
+				{
+					raised = DOUBLE_CLICKED_FLAG;
+				}
+				beginWrite();
+				storeTime(lastClickTime, now);
+				storeFlags(PRESSED_FLAG | raised);
+				endWrite();
+			}
+			else
+			{ // button has been released
+				if (now - lastClickTime > timings.longRelease)
+					raised = LONG_RELEASED_FLAG;
+				else
+					raised = SHORT_RELEASED_FLAG;
+				beginWrite();
+				storeTime(lastReleaseTime, now);
+				releaseFlags(raised);
+				endWrite();
+			}
+		}
+		lastChangeTime = now;
+		return raised;
+	}
+
+private:
+	/**
+	* Fills times from the timestamps and the flags they were read with.
+	*/
+	void readTimes(uint8_t flags, unsigned long now, Times& times) const volatile __attribute__((always_inline))
+	{
+#if BUTTONS_ATOMIC_FLAGS
+		times.press = __atomic_load_n(&lastClickTime, __ATOMIC_ACQUIRE);
+		times.release = __atomic_load_n(&lastReleaseTime, __ATOMIC_ACQUIRE);
+#else
+		times.press = lastClickTime;
+		times.release = lastReleaseTime;
+#endif
+		times.duration = ((flags & PRESSED_FLAG) ? now : times.release) - times.press;
+	}
+
+	/**
+	* Writes a timestamp that times() and take() may be reading on another core.
+	*/
+	static void storeTime(volatile unsigned long& time, unsigned long now) __attribute__((always_inline))
+	{
+#if BUTTONS_ATOMIC_FLAGS
+		__atomic_store_n(&time, now, __ATOMIC_RELEASE);
+#else
+		time = now;
+#endif
+	}
+
+	/**
+	* Seqlock around the writes of the ISR and the reads of times() and take(), which retry when
+	* they overlapped a write. The timestamps and the flags are written with release and read
+	* with acquire, which keeps them inside the odd count without fences.
+	* Without BUTTONS_ATOMIC_FLAGS the readers disable interrupts instead.
+	*/
+	void beginWrite() volatile __attribute__((always_inline))
+	{
+#if BUTTONS_ATOMIC_FLAGS
+		__atomic_store_n(&sequence, (uint16_t)(sequence + 1), __ATOMIC_RELAXED);
+#endif
+	}
+
+	void endWrite() volatile __attribute__((always_inline))
+	{
+#if BUTTONS_ATOMIC_FLAGS
+		__atomic_store_n(&sequence, (uint16_t)(sequence + 1), __ATOMIC_RELEASE);
+#endif
+	}
+
+#if BUTTONS_ATOMIC_FLAGS
+	uint16_t beginRead() const volatile __attribute__((always_inline))
+	{
+		uint16_t count;
+		while ((count = __atomic_load_n(&sequence, __ATOMIC_ACQUIRE)) & 1)
+		{
+		}
+		return count;
+	}
+
+	bool retryRead(uint16_t count) const volatile __attribute__((always_inline))
+	{
+		return __atomic_load_n(&sequence, __ATOMIC_RELAXED) != count;
+	}
+#endif
+
+	/**
+	* Reads the flags from the ISR, while another core may be taking one of them.
+	*/
+	uint8_t loadFlags() const volatile __attribute__((always_inline))
+	{
+#if BUTTONS_ATOMIC_FLAGS
+		return __atomic_load_n(&state, __ATOMIC_RELAXED);
+#else
+		return state;
+#endif
+	}
+
+	/**
+	* Replaces all the flags, discarding the events not taken yet.
+	*/
+	void storeFlags(uint8_t flags) volatile __attribute__((always_inline))
+	{
+#if BUTTONS_ATOMIC_FLAGS
+		__atomic_store_n(&state, flags, __ATOMIC_RELEASE);
+#else
+		state = flags;
+#endif
+	}
+
+	/**
+	* Clears PRESSED_FLAG and raises a release flag in a single step.
+	*/
+	void releaseFlags(uint8_t flag) volatile __attribute__((always_inline))
+	{
+#if BUTTONS_ATOMIC_FLAGS
+		uint8_t flags = __atomic_load_n(&state, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&state, &flags, (uint8_t)((flags & ~PRESSED_FLAG) | flag),
+			true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		{
+		}
+#else
+		state = (state & ~PRESSED_FLAG) | flag;
+#endif
+	}
+};
+
+/**
+* This structure encompasses information relating to an individual button.
+*/
+struct Button : ButtonState
+{
+	/**
+	* Stores pin number of the button.
+	*/
+	uint8_t pin;
+
+	/**
+	* Constructor for objects of Button.
+	*/
+	Button() :
+		pin(0)
+	{
+	}
+};
+
+/**
+* Selects the smallest index type able to count all the buttons of a class.
+*/
+template <bool Wide>
+struct ButtonIndexType
+{
+	typedef uint8_t type;
+};
+
+template <>
+struct ButtonIndexType<true>
+{
+	typedef uint16_t type;
+};
+
+/**
+* Function called by the ISR for every click or release flag it raises, and every encoder
+* detent: the button index, the ButtonState flag raised (STEP_UP_FLAG or STEP_DOWN_FLAG for
+* detents), the time of the edge and, for SHORT_RELEASED_FLAG and LONG_RELEASED_FLAG, how long
+* the press lasted (0 for the other flags), all in BUTTONS_NOW() ticks.
+* It runs in interrupt context, so it must be short and must not block.
+*/
+typedef void (*ButtonEventHandler)(uint16_t buttonId, uint8_t flag, unsigned long time, unsigned long duration);
+
+/**
+* Raises the "event pending" indication of a buttons class and reports the event to its handler, from the ISR.
+*/
+inline void buttonsRaiseEvent(volatile bool& pending, ButtonEventHandler handler, uint16_t buttonId, uint8_t flag, unsigned long now,
+	unsigned long duration) __attribute__((always_inline));
+
+inline void buttonsRaiseEvent(volatile bool& pending, ButtonEventHandler handler, uint16_t buttonId, uint8_t flag, unsigned long now,
+	unsigned long duration)
+{
+	buttonsRaisePending(pending);
+	if (handler != nullptr) handler(buttonId, flag, now, duration);
+}
+
+/**
+* Sleeps with BUTTONS_ENTER_SLEEP() until the "event pending" indication of a buttons class is
+* raised, or the timeout in milliseconds (0 for none) has elapsed. The callers check first that
+* their buttons are running and idle. Returns true if the core slept.
+*/
+inline bool buttonsSleepUntilEvent(volatile bool& pending, uint32_t timeout)
+{
+	uint32_t start = millis();
+	bool slept = false;
+	noInterrupts();
+	// Test the flag with interrupts disabled, so an event raised just before sleeping still wakes us.
+	while (!pending && (timeout == 0 || millis() - start < timeout))
+	{
+		BUTTONS_ENTER_SLEEP();
+		slept = true;
+	}
+	interrupts();
+	return slept;
+}
+
+/**
+ * This static-only template class holds the state of a set of buttons and implements the
+ * accessors shared by every buttons class. The Derived class is only used to give each
+ * buttons class its own static storage; it provides begin(), stop() and the ISR.
+ */
+template <class Derived, const uint16_t NumberOfButtons, class State>
+class ButtonsBase
+{
+public:
+	/**
+	* Type of the button indexes: uint8_t up to 255 buttons, uint16_t above that.
+	*/
+	typedef typename ButtonIndexType<(NumberOfButtons > 255)>::type ButtonIndex;
+
+	/**
+	 * Completes a start made with beginAsync(): once the pull-ups have had BUTTON_SETTLE_DELAY
+	 * milliseconds to settle, the initial button states are captured and the interrupts attached.
+	 * Call it from loop() or a periodic tick until it returns true; after that it only tests a flag.
+	 *
+	 * @return                  true if the buttons are running.
+	 */
+	static bool update()
+	{
+		if (_start.begun) return true;
+		if (!_start.due()) return false;
+		Derived::arm();
+		return true;
+	}
+
+	/**
+	 * Returns how many milliseconds are left before every debounce, double click and long release
+	 * window of every button has closed, or 0 if the buttons are idle now.
+	 * While the buttons are idle the next edge classifies the same way no matter how much time
+	 * passes, so the core may sleep (even with the millisecond tick halted) without
+	 * affecting the timing logic. Tickless applications can use this as their next timer deadline.
+	 *
+	 * @return                  Milliseconds until idle, 0 if already idle.
+	 */
+	static uint32_t msUntilIdle();
+
+	/**
+	 * Puts the core to sleep, with the button interrupts armed as wake sources, until a button
+	 * raises an event. Nothing is done if the buttons are not idle (see msUntilIdle()) or
+	 * if an event is already pending.
+	 * The edge that wakes the core is timestamped with the clock as it resumes, and because
+	 * the core only sleeps while idle, the elapsed sleep time never shortens a debounce or long
+	 * release measurement.
+	 *
+	 * @param timeout           Maximum time to stay asleep in milliseconds, 0 for no limit.
+	 *                          Only honoured by sleep modes that keep millis() running.
+	 * @return                  true if the core slept, false if it was not idle or an
+	 *                          event was already pending.
+	 */
+	static bool sleepUntilEvent(uint32_t timeout = 0);
+
+	/**
+	 * Returns a bool value indicating if the user has "clicked" the button,
+	 * defined as the button being down and the Change Flag set.
+	 *
+	 * @param buttonId          Index of the button whose status is to be checked.
+	 * @return                  true if the button has been clicked, false otherwise.
+	 */
+	static bool clicked(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return _buttons[buttonId].take(State::CLICKED_FLAG);
+	}
+
+	/**
+	* Returns a bool value indicating if the user has "released" the button,
+	* defined as the button being up and the Change Flag set.
+	*
+	* @param buttonId          Index of the button whose status is to be checked.
+	* @param clearChangeFlag   If true, the Change Flag for this button will be cleared at the same time.
+	* @return                  true if the button has been clicked since the Change Flag
+	*                          was last cleared, false otherwise.
+	*/
+	static bool shortReleased(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return _buttons[buttonId].take(State::SHORT_RELEASED_FLAG);
+	}
+
+	/**
+	* Returns a bool value indicating if the user has "released" the button,
+	* after being pressed for at least the period Timeout of milliseconds.
+	* Defined as the button being up and the Change Flag set.
+	*
+	* @param buttonId          Index of the button whose status is to be checked.
+	* @param clearChangeFlag   If true, the Change Flag for this button will be cleared at the same time.
+	* @return                  true if the button has been clicked since the Change Flag
+	*                          was last cleared, false otherwise.
+	*/
+	static bool longReleased(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return _buttons[buttonId].take(State::LONG_RELEASED_FLAG);
+	}
+
+	static bool doubleClicked(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return _buttons[buttonId].take(State::DOUBLE_CLICKED_FLAG);
+	}
+
+	/**
+	 * Returns a bool value indicating if the button is currently "down"/"pressed".
+	 * This return value is independent of the state of the Change Flag, however you can
+	 * clear the Change Flag if desired.
+	 * It is the opposite of the up() method.
+	 *
+	 * @param buttonId          Index of the button whose status is to be checked.
+	 * @param clearChangeFlag   If true, the Change Flag for this button will be cleared at the same time.
+	 * @return                  true if the button is down.
+	 */
+	static bool down(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return (_buttons[buttonId].state & State::PRESSED_FLAG) != 0;
+	}
+
+	/**
+	 * Returns a bool value indicating if the button is currently "up"/"not pressed".
+	 * This return value is independent of the state of the Change Flag, however you can
+	 * clear the Change Flag if desired.
+	 * It is the opposite of the down() method.
+	 *
+	 * @param buttonId          Index of the button whose status is to be checked.
+	 * @param clearChangeFlag   If true, the Change Flag for this button will be cleared at the same time.
+	 * @return                  true if the button is up.
+	 */
+	static bool up(ButtonIndex buttonId) __attribute__((always_inline))
+	{
+		return !down(buttonId);
+	}
+
+	/**
+	 * Returns the time the button was last pressed, as captured by the ISR.
+	 * Times are BUTTONS_NOW() values: milliseconds, or microseconds with BUTTONS_MICROS.
+	 *
+	 * @param buttonId          Index of the button whose status is to be checked.
+	 */
+	static unsigned long pressTime(ButtonIndex buttonId)
+	{
+		return _buttons[buttonId].times(BUTTONS_NOW()).press;
+	}
+
+	/**
+	 * Returns the time the button was last released, as captured by the ISR.
+	 *
+	 * @param buttonId          Index of the button whose status is to be checked.
+	 */
+	static unsigned long releaseTime(ButtonIndex buttonId)
+	{
+		return _buttons[buttonId].times(BUTTONS_NOW()).release;
+	}
+
+	/**
+	 * Returns the exact duration of the last press, measured between the ISR timestamps
+	 * of the press and the release. While the button is still down, returns how long
+	 * it has been held so far.
+	 *
+	 * @param buttonId          Index of the button whose status is to be checked.
+	 */
+	static unsigned long pressDuration(ButtonIndex buttonId)
+	{
+		return _buttons[buttonId].times(BUTTONS_NOW()).duration;
+	}
+
+	/**
+	 * Takes a click or release flag like clicked() etc, together with the press and release
+	 * timestamps and the duration of the press that raised it, read in one critical section.
+	 *
+	 * @param buttonId          Index of the button whose status is to be checked.
+	 * @param flag              The State flag to take, e.g. State::LONG_RELEASED_FLAG.
+	 * @param times             Receives the timestamps and the duration.
+	 * @return                  true if the flag was set.
+	 */
+	static bool take(ButtonIndex buttonId, uint8_t flag, ButtonState::Times& times)
+	{
+		return _buttons[buttonId].take(flag, BUTTONS_NOW(), times);
+	}
+
+	/**
+	 * Changes the periods used to classify the button edges, in milliseconds.
+	 * The long release period is the press duration above which a release is reported
+	 * by longReleased() instead of shortReleased().
+	 */
+	static void setDebounceDelay(unsigned long ms) { ButtonTimings::set(_timings.debounce, ms); }
+	static void setDoubleClickDelay(unsigned long ms) { ButtonTimings::set(_timings.doubleClick, ms); }
+	static void setLongReleaseDelay(unsigned long ms) { ButtonTimings::set(_timings.longRelease, ms); }
+
+	/**
+	 * Writes the periods and the pin map of this class to a ButtonsConfig blob.
+	 *
+	 * @param config            Buffer receiving the blob.
+	 * @param size              Size of the buffer, at least ButtonsConfig::size(numberOfButtons()).
+	 * @return                  Number of bytes written, 0 if the buffer is too small or a
+	 *                          period is longer than ButtonsConfig::MAX_PERIOD (65535 ms).
+	 */
+	static uint16_t saveConfig(uint8_t config[], uint16_t size);
+
+	/**
+	 * Validates a ButtonsConfig blob and applies its periods. The pin map is only used by
+	 * Buttons::beginFromConfig(); the other classes have their pins fixed at compile time.
+	 *
+	 * @param config            The blob, e.g. read back from EEPROM.
+	 * @param size              Size of the blob.
+	 * @return                  false, changing nothing, if the blob is not valid for this class.
+	 */
+	static bool loadConfig(const uint8_t config[], uint16_t size);
+
+	/**
+	 * Sets a function called by the ISR for every event it raises, e.g. ButtonEventQueue::post,
+	 * or nullptr to remove it. The flags are still raised for the accessors.
+	 */
+	static void setEventHandler(ButtonEventHandler handler)
+	{
+		ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+		_eventHandler = handler;
+		buttonsRestoreInterrupts(interruptState);
+	}
+
+		/**
+		 * Returns the number of buttons currently controlled by this class.
+		 *
+		 * @return    The number of buttons controlled by this class
+		 */
+	static uint16_t numberOfButtons() __attribute__((always_inline))
+	{
+		return NumberOfButtons;
+	}
+
+	/**
+	 * Returns true if the ISR has raised any new click/release flag since the last call,
+	 * and clears that indication. This is a single byte test, so schedulers can poll it
+	 * on every loop iteration and only scan the buttons when something actually happened.
+	 *
+	 * @return                  true if at least one new event was raised since the last call.
+	 */
+	static bool eventPending() __attribute__((always_inline))
+	{
+		return buttonsTakePending(_eventPending);
+	}
+
+	//This class has only static members, therefore constructors etc are pointless.
+	ButtonsBase() = delete;
+	~ButtonsBase() = delete;
+	ButtonsBase& operator=(const ButtonsBase&) = delete;
+	ButtonsBase(const ButtonsBase&) = delete;
+
+protected:
+	/**
+	* Runs the classification of one button from the ISR.
+	*/
+	static void updateButton(ButtonIndex buttonId, bool readState, unsigned long now) __attribute__((always_inline))
+	{
+		uint8_t raised = _buttons[buttonId].update(readState, now, _timings);
+		if (raised != State::CLEAR_FLAGS) raiseEvent(buttonId, raised, now, _buttons[buttonId].eventDuration(raised, now));
+	}
+
+	/**
+	* Raises the event indication and reports the event to the handler, from the ISR.
+	*/
+	static void raiseEvent(ButtonIndex buttonId, uint8_t flag, unsigned long now, unsigned long duration) __attribute__((always_inline))
+	{
+		buttonsRaiseEvent(_eventPending, _eventHandler, buttonId, flag, now, duration);
+	}
+
+	/**
+	* Sets the initial state of one button from a reading taken with interrupts not yet attached.
+	*/
+	static void reset(ButtonIndex buttonId, bool readState, unsigned long now)
+	{
+		_buttons[buttonId].reset(readState, now);
+	}
+
+	/**
+	* This array stores the state objects for each button controlled by this class,
+	* each containing relevant information for the servicing of the ISR.
+	* Its volatile because its members may be modified by an ISR, so we need to
+	* prevent register caching of member values.
+	*/
+	static volatile State _buttons[NumberOfButtons];
+
+	/**
+	* Set to true by the ISR whenever it raises an event flag, cleared by eventPending().
+	*/
+	static volatile bool _eventPending;
+
+	/**
+	* Periods used by the ISR, in BUTTONS_NOW() ticks.
+	*/
+	static ButtonTimings _timings;
+
+	/**
+	* Called by the ISR for every event raised, if set.
+	*/
+	static ButtonEventHandler volatile _eventHandler;
+
+	/**
+	* Marks the pins as configured, to be armed by update() once BUTTON_SETTLE_DELAY has elapsed.
+	*/
+	static void startArming()
+	{
+		_start.configured();
+	}
+
+	/**
+	* Records that the interrupts are attached and the buttons are running.
+	*/
+	static void armed()
+	{
+		_start.armed();
+	}
+
+	/**
+	* Cancels a pending start and marks the buttons as stopped.
+	* Returns true if the interrupts were attached, so that stop() detaches them.
+	*/
+	static bool stopping()
+	{
+		return _start.stop();
+	}
+
+	/**
+	* Whether this class has been started, or is waiting for its pins to settle.
+	*/
+	static ButtonsStart _start;
+};
+
+template <class Derived, uint16_t NumberOfButtons, class State>
+ButtonsStart ButtonsBase<Derived, NumberOfButtons, State>::_start;
+
+template <class Derived, uint16_t NumberOfButtons, class State>
+volatile bool ButtonsBase<Derived, NumberOfButtons, State>::_eventPending = false;
+
+template <class Derived, uint16_t NumberOfButtons, class State>
+ButtonTimings ButtonsBase<Derived, NumberOfButtons, State>::_timings;
+
+template <class Derived, uint16_t NumberOfButtons, class State>
+ButtonEventHandler volatile ButtonsBase<Derived, NumberOfButtons, State>::_eventHandler = nullptr;
+
+template <class Derived, uint16_t NumberOfButtons, class State>
+volatile State ButtonsBase<Derived, NumberOfButtons, State>::_buttons[NumberOfButtons];
 
-	/**
-	* Constructor for objects of Button.
-	*/
-	Button() :
-		pin(0),
-		state(0),
-		//		currentState(false),
-		//		changeFlag(false),
-		//		longClickFlag(false),
-		lastChangeTime(0),
-		lastClickTime(0)
+template <class Derived, uint16_t NumberOfButtons, class State>
+uint32_t ButtonsBase<Derived, NumberOfButtons, State>::msUntilIdle()
+{
+	unsigned long now = BUTTONS_NOW();
+	unsigned long remaining = 0;
+	ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+	for (ButtonIndex i = 0; i < NumberOfButtons; i++)
 	{
+		unsigned long button = _buttons[i].ticksUntilIdle(now, _timings);
+		if (button > remaining) remaining = button;
 	}
-};
+	buttonsRestoreInterrupts(interruptState);
+	return ButtonTimings::roundUpToMs(remaining);
+}
+
+template <class Derived, uint16_t NumberOfButtons, class State>
+uint16_t ButtonsBase<Derived, NumberOfButtons, State>::saveConfig(uint8_t config[], uint16_t size)
+{
+	if (!ButtonsConfig::writeHeader(config, size, NumberOfButtons, _timings)) return 0;
+
+	for (ButtonIndex i = 0; i < NumberOfButtons; i++)
+		config[ButtonsConfig::HEADER_SIZE + i] = Derived::pin(i);
+	return ButtonsConfig::seal(config, NumberOfButtons);
+}
+
+template <class Derived, uint16_t NumberOfButtons, class State>
+bool ButtonsBase<Derived, NumberOfButtons, State>::loadConfig(const uint8_t config[], uint16_t size)
+{
+	if (!ButtonsConfig::valid(config, size, NumberOfButtons)) return false;
+
+	ButtonsConfig::apply(config, _timings);
+	return true;
+}
+
+template <class Derived, uint16_t NumberOfButtons, class State>
+bool ButtonsBase<Derived, NumberOfButtons, State>::sleepUntilEvent(uint32_t timeout)
+{
+	if (!_start.begun || msUntilIdle() != 0) return false;
+
+	return buttonsSleepUntilEvent(_eventPending, timeout);
+}
 
 /**
  * This static-only template class implements a system for getting user input from buttons.
@@ -86,10 +1203,13 @@ struct Button
  * On the Arduino Due (for example) all digital pins can be used in this way, but on
  * the Arduino Uno, only pins 2 and 3 can have interrupts attached.
  */
-template <const uint8_t NumberOfButtons>
-class Buttons final
+template <const uint16_t NumberOfButtons>
+class Buttons final : public ButtonsBase<Buttons<NumberOfButtons>, NumberOfButtons, Button>
 {
+	using Base = ButtonsBase<Buttons<NumberOfButtons>, NumberOfButtons, Button>;
+
 public:
+	typedef typename Base::ButtonIndex ButtonIndex;
 
 	/**
 	 * Initialize the buttons as attached to the specified pins and attach appropriate interrupts.
@@ -105,108 +1225,43 @@ public:
 	static bool begin(const uint8_t buttonPins[]);
 
 	/**
-	 * Detach interrupts from the pins controlled by this object.
-	 * If the object has not been started with begin(), or begin() failed, calling this will do nothing.
-	 */
-	static void stop();
-
-	/**
-	 * Returns a bool value indicating if the user has "clicked" the button,
-	 * defined as the button being down and the Change Flag set.
+	 * Same as begin(), but does not wait for the pull-ups to settle: the pins are configured
+	 * immediately and the interrupts are attached by the first update() call made at least
+	 * BUTTON_SETTLE_DELAY milliseconds later.
 	 *
-	 * @param buttonId          Index of the button whose status is to be checked.
-	 * @return                  true if the button has been clicked, false otherwise.
+	 * @param buttonPins        Same as for begin().
+	 * @return                  true on success, false on failure.
 	 */
-	static bool clicked(uint8_t buttonId) __attribute__((always_inline))
-	{
-		uint8_t bClicked = _buttons[buttonId].state & CLICKED_FLAG;
-		_buttons[buttonId].state &= ~CLICKED_FLAG;
-		return bClicked != 0;
-	}
-
-	/**
-	* Returns a bool value indicating if the user has "released" the button,
-	* defined as the button being up and the Change Flag set.
-	*
-	* @param buttonId          Index of the button whose status is to be checked.
-	* @param clearChangeFlag   If true, the Change Flag for this button will be cleared at the same time.
-	* @return                  true if the button has been clicked since the Change Flag
-	*                          was last cleared, false otherwise.
-	*/
-	static bool shortReleased(uint8_t buttonId) __attribute__((always_inline))
-	{
-		uint8_t bShortReleased = _buttons[buttonId].state & SHORT_RELEASED_FLAG;
-		_buttons[buttonId].state &= ~SHORT_RELEASED_FLAG;
-		return bShortReleased != 0;
-	}
-
-	/**
-	* Returns a bool value indicating if the user has "released" the button,
-	* after being pressed for at least the period Timeout of milliseconds.
-	* Defined as the button being up and the Change Flag set.
-	*
-	* @param buttonId          Index of the button whose status is to be checked.
-	* @param clearChangeFlag   If true, the Change Flag for this button will be cleared at the same time.
-	* @return                  true if the button has been clicked since the Change Flag
-	*                          was last cleared, false otherwise.
-	*/
-	static bool longReleased(uint8_t buttonId) __attribute__((always_inline))
-	{
-		uint8_t blongReleased = _buttons[buttonId].state & LONG_RELEASED_FLAG;
-		_buttons[buttonId].state &= ~LONG_RELEASED_FLAG;
-		return blongReleased != 0;
-	}
-
-	static bool doubleClicked(uint8_t buttonId) __attribute__((always_inline))
-	{
-		uint8_t bDoubleClicked = _buttons[buttonId].state & DOUBLE_CLICKED_FLAG;
-		_buttons[buttonId].state &= ~DOUBLE_CLICKED_FLAG;
-		return bDoubleClicked != 0;
-	}
+	static bool beginAsync(const uint8_t buttonPins[]);
 
 	/**
-	 * Returns a bool value indicating if the button is currently "down"/"pressed".
-	 * This return value is independent of the state of the Change Flag, however you can
-	 * clear the Change Flag if desired.
-	 * It is the opposite of the up() method.
+	 * Same as begin(), but takes the pins and the periods from a ButtonsConfig blob saved by
+	 * saveConfig(), validated and applied in one pass. For a non-blocking start, call
+	 * loadConfig() and then beginAsync(ButtonsConfig::pins(config)).
 	 *
-	 * @param buttonId          Index of the button whose status is to be checked.
-	 * @param clearChangeFlag   If true, the Change Flag for this button will be cleared at the same time.
-	 * @return                  true if the button is down.
+	 * @param config            The blob, e.g. read back from EEPROM.
+	 * @param size              Size of the blob.
+	 * @return                  true on success, false if the blob is not valid for this class.
 	 */
-	static bool down(uint8_t buttonId) __attribute__((always_inline))
+	static bool beginFromConfig(const uint8_t config[], uint16_t size)
 	{
-		return (_buttons[buttonId].state & PRESSED_FLAG) != 0;
+		return Base::loadConfig(config, size) && begin(ButtonsConfig::pins(config));
 	}
 
 	/**
-	 * Returns a bool value indicating if the button is currently "up"/"not pressed".
-	 * This return value is independent of the state of the Change Flag, however you can
-	 * clear the Change Flag if desired.
-	 * It is the opposite of the down() method.
-	 *
-	 * @param buttonId          Index of the button whose status is to be checked.
-	 * @param clearChangeFlag   If true, the Change Flag for this button will be cleared at the same time.
-	 * @return                  true if the button is up.
+	 * Detach interrupts from the pins controlled by this object.
+	 * If the object has not been started with begin(), or begin() failed, calling this will do nothing.
 	 */
-	static bool up(uint8_t buttonId) __attribute__((always_inline))
-	{
-		return !down(buttonId);
-	}
+	static void stop();
 
-		/**
-		 * Returns the number of buttons currently controlled by this class.
-		 *
-		 * @return    The number of buttons controlled by this class
-		 */
-	static uint8_t numberOfButtons() __attribute__((always_inline))
+	static bool polledDown(ButtonIndex buttonId) __attribute__((always_inline))
 	{
-		return NumberOfButtons;
+		return digitalRead(Base::_buttons[buttonId].pin) == LOW;
 	}
 
-	static bool polledDown(uint8_t buttonId) __attribute__((always_inline))
+	static uint8_t pin(ButtonIndex buttonId) __attribute__((always_inline))
 	{
-		return digitalRead(_buttons[buttonId].pin) == LOW;
+		return Base::_buttons[buttonId].pin;
 	}
 
 	//This class has only static members, therefore constructors etc are pointless.
@@ -216,12 +1271,12 @@ public:
 	Buttons(const Buttons&) = delete;
 
 private:
-	static constexpr uint8_t CLEAR_FLAGS = 0;
-	static constexpr uint8_t PRESSED_FLAG = _BV(0);
-	static constexpr uint8_t CLICKED_FLAG = _BV(1);
-	static constexpr uint8_t SHORT_RELEASED_FLAG = _BV(2);
-	static constexpr uint8_t LONG_RELEASED_FLAG = _BV(3);
-	static constexpr uint8_t DOUBLE_CLICKED_FLAG = _BV(4);
+	friend Base;
+
+	/**
+	* Attaches the interrupts and captures the initial state of the buttons.
+	*/
+	static void arm();
 
 	/**
 	* This function is called whenever a button interrupt is fired.
@@ -229,118 +1284,340 @@ private:
 	* accordingly.
 	*/
 	static void button_ISR();
-
-	/**
-	* This array stores Button objects for each button controlled by this class,
-	* each containing relevant information for the servicing of the ISR.
-	* Its volatile because its members may be modified by an ISR, so we need to
-	* prevent register caching of member values.
-	*/
-	//	static volatile Button _buttons[NumberOfButtons];
-	static volatile Button _buttons[NumberOfButtons];
-
-	/**
-	* Set to true if this class has been initialised, false otherwise.
-	*/
-	static bool _begun;
 };
 
-template <uint8_t NumberOfButtons>
-bool Buttons<NumberOfButtons>::_begun = false;
+template <uint16_t NumberOfButtons>
+bool Buttons<NumberOfButtons>::begin(const uint8_t buttonPins[])
+{
+	if (!beginAsync(buttonPins)) return false;
 
-template <uint8_t NumberOfButtons>
-volatile Button Buttons<NumberOfButtons>::_buttons[NumberOfButtons];
+	// Need to wait some time before setting up the ISRs, otherwise you can get spurious
+	// changes as the pullup hasn't quite done its magic yet.
+	delay(BUTTON_SETTLE_DELAY);
+	arm();
+	return true;
+}
 
-template <uint8_t NumberOfButtons>
-bool Buttons<NumberOfButtons>::begin(const uint8_t buttonPins[])
+template <uint16_t NumberOfButtons>
+bool Buttons<NumberOfButtons>::beginAsync(const uint8_t buttonPins[])
 {
 	// Abort if the buttonPins array is null
 	if (nullptr == buttonPins) return false;
 
 	// If Buttons has already been started, kill it before restarting it.
-	if (_begun) stop();
+	stop();
 
 	// Set up the input pins themselves.
-	for (uint8_t i = 0; i < NumberOfButtons; i++)
+	for (ButtonIndex i = 0; i < NumberOfButtons; i++)
 	{
-		_buttons[i].pin = buttonPins[i];
+		Base::_buttons[i].pin = buttonPins[i];
 		pinMode(buttonPins[i], INPUT_PULLUP);
 	}
 
-	// Need to wait some time before setting up the ISRs, otherwise you can get spurious
-	// changes as the pullup hasn't quite done its magic yet.
-	delay(10);
+	Base::startArming();
+	return true;
+}
 
+template <uint16_t NumberOfButtons>
+void Buttons<NumberOfButtons>::arm()
+{
 	//Set up the interrupts on the pins.
-	for (uint8_t i = 0; i < NumberOfButtons; i++)
+	for (ButtonIndex i = 0; i < NumberOfButtons; i++)
 	{
-		attachInterrupt(digitalPinToInterrupt(buttonPins[i]), &Buttons<NumberOfButtons>::button_ISR, CHANGE);
+		attachInterrupt(digitalPinToInterrupt(Base::_buttons[i].pin), &Buttons<NumberOfButtons>::button_ISR, CHANGE);
 	}
 
 	// initialize buttons state
-	for (uint8_t i = 0; i < NumberOfButtons; i++)
+	unsigned long now = BUTTONS_NOW();
+	for (ButtonIndex i = 0; i < NumberOfButtons; i++)
 	{
-		_buttons[i].state = digitalRead(_buttons[i].pin) ? CLEAR_FLAGS : PRESSED_FLAG;
-		_buttons[i].lastClickTime = _buttons[i].lastChangeTime = millis();
+		Base::reset(i, polledDown(i), now);
 	}
 
 	// All done.
-	_begun = true;
-	return true;
+	Base::armed();
 }
 
-template <uint8_t NumberOfButtons>
+template <uint16_t NumberOfButtons>
 void Buttons<NumberOfButtons>::stop()
 {
-	// If the object is already stopped, we don't need to do anything.
-	if (!_begun)
+	// A start still waiting for the pull-ups to settle has no interrupts to detach,
+	// and if the object is already stopped, we don't need to do anything.
+	if (!Base::stopping())
 		return;
 
 	//Disable the interrupts
-	for (uint8_t i = 0; i < NumberOfButtons; i++)
+	for (ButtonIndex i = 0; i < NumberOfButtons; i++)
 	{
-		detachInterrupt(digitalPinToInterrupt(_buttons[i].pin));
+		detachInterrupt(digitalPinToInterrupt(Base::_buttons[i].pin));
 	}
-
-	//Object has been stopped.
-	_begun = false;
 }
 
-template <uint8_t NumberOfButtons>
+template <uint16_t NumberOfButtons>
 void Buttons<NumberOfButtons>::button_ISR()
 {
-	uint32_t now = millis();
-	for (uint8_t i = 0; i < NumberOfButtons; i++)
+	unsigned long now = BUTTONS_NOW();
+	for (ButtonIndex i = 0; i < NumberOfButtons; i++)
 	{
-		bool readState = polledDown(i);
-		bool buttonState = down(i);
-		if (readState != buttonState)
-		{
-			if (now - _buttons[i].lastChangeTime > BUTTON_DEBOUNCE_DELAY)
-			{
-				if (readState) // button has been clicked
-				{
-					if (now - _buttons[i].lastClickTime > DOUBLE_CLICK_DELAY)
-					{
-						_buttons[i].state = PRESSED_FLAG | CLICKED_FLAG;
-					}
-					else
-					{
-						_buttons[i].state = PRESSED_FLAG | DOUBLE_CLICKED_FLAG;
-					}
-					_buttons[i].lastClickTime = now;
-				}
-				else
-				{ // button has been released
-					_buttons[i].state &= ~PRESSED_FLAG;
-					if (now - _buttons[i].lastClickTime > LONG_RELEASE_DELAY)
-						_buttons[i].state |= LONG_RELEASED_FLAG;
-					else
-						_buttons[i].state |= SHORT_RELEASED_FLAG;
+		Base::updateButton(i, polledDown(i), now);
+	}
+}
 
-				}
-			}
-			_buttons[i].lastChangeTime = now;
-		}
+/**
+* Compile-time description of a button pin: which port it belongs to, its bit mask and
+* its external interrupt. On the boards listed below the port and mask are constants, so
+* reading the button compiles down to a single port read. Elsewhere the pin falls back to
+* digitalRead() with a constant pin number, which still needs no pin table in RAM.
+*/
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168__)
+#define BUTTONS_CONSTEXPR_PORTS 1
+// Port indexes: 0 = PIND (D0-D7), 1 = PINB (D8-D13), 2 = PINC (A0-A5).
+#define BUTTONS_PORT_COUNT 3
+#else
+#define BUTTONS_CONSTEXPR_PORTS 0
+#define BUTTONS_PORT_COUNT 1
+#endif
+
+template <uint8_t Pin>
+struct ButtonPin
+{
+#if BUTTONS_CONSTEXPR_PORTS
+	static constexpr uint8_t port = Pin < 8 ? 0 : (Pin < 14 ? 1 : 2);
+	static constexpr uint8_t mask = Pin < 8 ? _BV(Pin) : (Pin < 14 ? _BV(Pin - 8) : (Pin < 20 ? _BV(Pin - 14) : 0));
+	static constexpr uint8_t interrupt = Pin == 2 ? 0 : (Pin == 3 ? 1 : NOT_AN_INTERRUPT);
+	static constexpr bool hasInterrupt = interrupt != NOT_AN_INTERRUPT;
+
+	static bool down(const uint8_t ports[]) __attribute__((always_inline))
+	{
+		return (ports[port] & mask) == 0;
+	}
+
+	static bool down() __attribute__((always_inline))
+	{
+		return ((port == 0 ? PIND : (port == 1 ? PINB : PINC)) & mask) == 0;
+	}
+#else
+	static constexpr uint8_t port = 0;
+	// Not known at compile time: digitalPinToInterrupt() is not constexpr on every core.
+	static constexpr bool hasInterrupt = true;
+
+	static bool down(const uint8_t[]) __attribute__((always_inline))
+	{
+		return down();
+	}
+
+	static bool down() __attribute__((always_inline))
+	{
+		return digitalRead(Pin) == LOW;
+	}
+#endif
+
+	static uint8_t interruptNumber() __attribute__((always_inline))
+	{
+#if BUTTONS_CONSTEXPR_PORTS
+		return interrupt;
+#else
+		return digitalPinToInterrupt(Pin);
+#endif
+	}
+};
+
+/**
+* Compile-time queries over a list of button pins.
+*/
+template <uint8_t... Pins>
+struct ButtonPinList;
+
+template <>
+struct ButtonPinList<>
+{
+	static constexpr bool usesPort(uint8_t) { return false; }
+	static constexpr uint8_t portMask(uint8_t) { return 0; }
+	static constexpr bool allMapped() { return true; }
+	static constexpr bool allInterrupts() { return true; }
+};
+
+template <uint8_t Pin, uint8_t... Pins>
+struct ButtonPinList<Pin, Pins...>
+{
+	static constexpr bool usesPort(uint8_t port)
+	{
+		return ButtonPin<Pin>::port == port || ButtonPinList<Pins...>::usesPort(port);
+	}
+
+	static constexpr uint8_t portMask(uint8_t port)
+	{
+		return (ButtonPin<Pin>::port == port ? ButtonPin<Pin>::mask : 0) | ButtonPinList<Pins...>::portMask(port);
+	}
+
+	/**
+	* Returns true if every pin is on one of the mapped ports (its mask is not 0).
+	*/
+	static constexpr bool allMapped()
+	{
+		return ButtonPin<Pin>::mask != 0 && ButtonPinList<Pins...>::allMapped();
+	}
+
+	/**
+	* Returns true if every pin has an external interrupt, as far as known at compile time.
+	*/
+	static constexpr bool allInterrupts()
+	{
+		return ButtonPin<Pin>::hasInterrupt && ButtonPinList<Pins...>::allInterrupts();
+	}
+};
+
+/**
+ * This static-only template class works like Buttons, but the pins are template arguments:
+ *
+ *   using buttons = StaticButtons<BUTTON1_PIN, BUTTON2_PIN>;
+ *   buttons::begin();
+ *
+ * Port registers, bit masks and interrupt numbers are resolved at compile time, the ISR
+ * reads each port used by the buttons only once, and no pin numbers are stored in RAM.
+ * Button indexes follow the order of the pins in the template argument list.
+ */
+template <uint8_t... Pins>
+class StaticButtons final : public ButtonsBase<StaticButtons<Pins...>, sizeof...(Pins), ButtonState>
+{
+	using Base = ButtonsBase<StaticButtons<Pins...>, sizeof...(Pins), ButtonState>;
+
+	// attachInterrupt(NOT_AN_INTERRUPT, ...) silently does nothing, and the buttons would never report.
+	static_assert(ButtonPinList<Pins...>::allInterrupts(), "Every pin must have an external interrupt (pins 2 and 3 on this board); use PcintButtons for the other pins");
+
+public:
+
+	/**
+	 * Initialize the buttons and attach the interrupts of their pins.
+	 *
+	 * @return                  true on success, false on failure.
+	 */
+	static bool begin();
+
+	/**
+	 * Same as begin(), but does not wait for the pull-ups to settle: the interrupts are
+	 * attached by the first update() call made at least BUTTON_SETTLE_DELAY milliseconds later.
+	 *
+	 * @return                  true on success, false on failure.
+	 */
+	static bool beginAsync();
+
+	/**
+	 * Detach interrupts from the pins controlled by this object.
+	 * If the object has not been started with begin(), calling this will do nothing.
+	 */
+	static void stop();
+
+	static bool polledDown(uint8_t buttonId)
+	{
+		uint8_t i = 0;
+		bool result = false;
+		int expand[] = { 0, (i++ == buttonId ? (result = ButtonPin<Pins>::down(), 0) : 0)... };
+		(void)expand;
+		return result;
+	}
+
+	static uint8_t pin(uint8_t buttonId)
+	{
+		static const uint8_t pins[] = { Pins... };
+		return pins[buttonId];
+	}
+
+	//This class has only static members, therefore constructors etc are pointless.
+	StaticButtons() = delete;
+	~StaticButtons() = delete;
+	StaticButtons& operator=(const StaticButtons&) = delete;
+	StaticButtons(const StaticButtons&) = delete;
+
+private:
+	friend Base;
+
+	/**
+	* Attaches the interrupts and captures the initial state of the buttons.
+	*/
+	static void arm();
+
+	/**
+	* Reads every port used by the buttons once, in a single snapshot.
+	*/
+	static void readPorts(uint8_t ports[]) __attribute__((always_inline))
+	{
+#if BUTTONS_CONSTEXPR_PORTS
+		if (ButtonPinList<Pins...>::usesPort(0)) ports[0] = PIND;
+		if (ButtonPinList<Pins...>::usesPort(1)) ports[1] = PINB;
+		if (ButtonPinList<Pins...>::usesPort(2)) ports[2] = PINC;
+#else
+		(void)ports;
+#endif
 	}
+
+	/**
+	* This function is called whenever a button interrupt is fired.
+	* It reads all the button states and updates their _buttons objects
+	* accordingly.
+	*/
+	static void button_ISR();
+};
+
+template <uint8_t... Pins>
+bool StaticButtons<Pins...>::begin()
+{
+	beginAsync();
+
+	// Need to wait some time before setting up the ISRs, otherwise you can get spurious
+	// changes as the pullup hasn't quite done its magic yet.
+	delay(BUTTON_SETTLE_DELAY);
+	arm();
+	return true;
+}
+
+template <uint8_t... Pins>
+bool StaticButtons<Pins...>::beginAsync()
+{
+	// If the buttons have already been started, kill them before restarting.
+	stop();
+
+	int pins[] = { 0, (pinMode(Pins, INPUT_PULLUP), 0)... };
+	(void)pins;
+
+	Base::startArming();
+	return true;
+}
+
+template <uint8_t... Pins>
+void StaticButtons<Pins...>::arm()
+{
+	int interrupts[] = { 0, (attachInterrupt(ButtonPin<Pins>::interruptNumber(), &StaticButtons<Pins...>::button_ISR, CHANGE), 0)... };
+	(void)interrupts;
+
+	// initialize buttons state
+	unsigned long now = BUTTONS_NOW();
+	uint8_t i = 0;
+	int states[] = { 0, (Base::reset(i++, ButtonPin<Pins>::down(), now), 0)... };
+	(void)states;
+
+	Base::armed();
+}
+
+template <uint8_t... Pins>
+void StaticButtons<Pins...>::stop()
+{
+	// A start still waiting for the pull-ups to settle has no interrupts to detach,
+	// and if the object is already stopped, we don't need to do anything.
+	if (!Base::stopping())
+		return;
+
+	int interrupts[] = { 0, (detachInterrupt(ButtonPin<Pins>::interruptNumber()), 0)... };
+	(void)interrupts;
+}
+
+template <uint8_t... Pins>
+void StaticButtons<Pins...>::button_ISR()
+{
+	unsigned long now = BUTTONS_NOW();
+	uint8_t ports[BUTTONS_PORT_COUNT];
+	readPorts(ports);
+	uint8_t i = 0;
+	int expand[] = { 0, (Base::updateButton(i++, ButtonPin<Pins>::down(ports), now), 0)... };
+	(void)expand;
 }
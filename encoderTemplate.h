@@ -0,0 +1,322 @@
+/*
+ *  Arduino Buttons Template Library - Rotary encoders
+ *  An interrupt-driven quadrature decoder sharing the pin and interrupt machinery of the buttons.
+ *
+ *  Copyright (C) 2017 Vital Holmo Batista
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+ *  USA
+ */
+
+#pragma once
+#include <buttonsTemplate.h>
+
+/**
+* Quadrature transitions between two detents (4 for most panel encoders, 2 or 1 for others).
+* Acceleration: steps closer together than ENCODER_ACCEL_INTERVAL milliseconds count up to
+* ENCODER_ACCEL_MAX times in readAccelerated(), scaling linearly with speed.
+* Can be overridden in user files by #defining them before including this file.
+*/
+#ifndef ENCODER_STEPS_PER_DETENT
+#define ENCODER_STEPS_PER_DETENT 4
+#endif
+#ifndef ENCODER_ACCEL_INTERVAL
+#define ENCODER_ACCEL_INTERVAL 40
+#endif
+#ifndef ENCODER_ACCEL_MAX
+#define ENCODER_ACCEL_MAX 10
+#endif
+
+/**
+* Pass as SwitchPin for encoders without a push switch.
+*/
+#define ENCODER_NO_SWITCH 0xFF
+
+/**
+ * This static-only template class decodes a quadrature rotary encoder on PinA/PinB and,
+ * optionally, its push switch on SwitchPin:
+ *
+ *   using encoder = RotaryEncoder<ENC_A_PIN, ENC_B_PIN, ENC_SW_PIN>;
+ *   encoder::begin();
+ *   int16_t steps = encoder::read();
+ *   if (encoder::clicked(0)) ...
+ *
+ * The switch is button 0 of the usual buttons accessors and goes through the same debounce
+ * and click classification. Detents go through the same event path as button events: they
+ * raise the event indication, so eventPending(), sleepUntilEvent() and ButtonsAwait::dispatch()
+ * also wake up on rotation, and are reported to the event handler as STEP_UP_FLAG or
+ * STEP_DOWN_FLAG of button 0. ButtonsAwait::rotated() waits for them.
+ *
+ * Decoding is table driven: each edge on A or B looks up the (previous, current) state pair,
+ * impossible transitions caused by bounces or missed edges count as 0, and steps are only
+ * emitted when the encoder reaches a detent position, so a lost transition never shifts the
+ * detent alignment. Both pins must be able to have interrupts attached to them.
+ */
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin = ENCODER_NO_SWITCH>
+class RotaryEncoder final : public ButtonsBase<RotaryEncoder<PinA, PinB, SwitchPin>, 1, ButtonState>
+{
+	using Base = ButtonsBase<RotaryEncoder<PinA, PinB, SwitchPin>, 1, ButtonState>;
+
+	static_assert(ButtonPinList<PinA, PinB>::allInterrupts() && (SwitchPin == ENCODER_NO_SWITCH || ButtonPin<SwitchPin>::hasInterrupt),
+		"Every encoder pin must have an external interrupt (pins 2 and 3 on this board); use PcintButtons for the other pins");
+
+public:
+
+	/**
+	 * Initialize the encoder pins and attach the interrupts.
+	 *
+	 * @return                  true on success, false on failure.
+	 */
+	static bool begin();
+
+	/**
+	 * Same as begin(), but does not wait for the pull-ups to settle: the interrupts are
+	 * attached by the first update() call made at least BUTTON_SETTLE_DELAY milliseconds later.
+	 *
+	 * @return                  true on success, false on failure.
+	 */
+	static bool beginAsync();
+
+	/**
+	 * Detach interrupts from the pins controlled by this object.
+	 * If the object has not been started with begin(), calling this will do nothing.
+	 */
+	static void stop();
+
+	/**
+	 * Returns the number of detents turned since the last call, positive when A leads B.
+	 * Independent of readAccelerated(): use one or the other.
+	 */
+	static int16_t read()
+	{
+		ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+		int16_t steps = _steps;
+		_steps = 0;
+		buttonsRestoreInterrupts(interruptState);
+		return steps;
+	}
+
+	/**
+	 * Same as read(), but steps turned faster than one per ENCODER_ACCEL_INTERVAL count
+	 * more, up to ENCODER_ACCEL_MAX each. Meant for scrolling through large ranges.
+	 */
+	static int16_t readAccelerated()
+	{
+		ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+		int16_t steps = _accelSteps;
+		_accelSteps = 0;
+		buttonsRestoreInterrupts(interruptState);
+		return steps;
+	}
+
+	/**
+	 * Returns the current turning speed in detents per second, measured between the
+	 * last two detents, or 0 if the encoder has not moved during the last second.
+	 */
+	static uint16_t stepsPerSecond()
+	{
+		ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+		uint32_t stepTime = _lastStepTime;
+		uint16_t interval = _stepInterval;
+		buttonsRestoreInterrupts(interruptState);
+		if (millis() - stepTime >= 1000) return 0;
+		return interval == 0 ? 1000 : 1000 / interval;
+	}
+
+	/**
+	 * Returns the time of the last detent, from millis().
+	 */
+	static uint32_t lastStepTime()
+	{
+		ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+		uint32_t time = _lastStepTime;
+		buttonsRestoreInterrupts(interruptState);
+		return time;
+	}
+
+	static bool polledDown(uint8_t) __attribute__((always_inline))
+	{
+		return HasSwitch && ButtonPin<SwitchPin>::down();
+	}
+
+	static uint8_t pin(uint8_t) __attribute__((always_inline))
+	{
+		return SwitchPin;
+	}
+
+	//This class has only static members, therefore constructors etc are pointless.
+	RotaryEncoder() = delete;
+	~RotaryEncoder() = delete;
+	RotaryEncoder& operator=(const RotaryEncoder&) = delete;
+	RotaryEncoder(const RotaryEncoder&) = delete;
+
+private:
+	friend Base;
+
+	static constexpr bool HasSwitch = SwitchPin != ENCODER_NO_SWITCH;
+
+	/**
+	* Attaches the interrupts and captures the initial state of the encoder.
+	*/
+	static void arm();
+
+	/**
+	* Returns the A/B levels as a 2-bit Gray code, A in bit 1.
+	*/
+	static uint8_t readState() __attribute__((always_inline))
+	{
+		return (ButtonPin<PinA>::down() ? 0 : 2) | (ButtonPin<PinB>::down() ? 0 : 1);
+	}
+
+	/**
+	* Called whenever A or B changes.
+	*/
+	static void encoder_ISR();
+
+	/**
+	* Called whenever the switch pin changes.
+	*/
+	static void button_ISR();
+
+	static volatile uint8_t _state;
+	static volatile int8_t _quarterSteps;
+	static volatile int16_t _steps;
+	static volatile int16_t _accelSteps;
+	static volatile uint32_t _lastStepTime;
+	static volatile uint16_t _stepInterval;
+};
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+volatile uint8_t RotaryEncoder<PinA, PinB, SwitchPin>::_state = 0;
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+volatile int8_t RotaryEncoder<PinA, PinB, SwitchPin>::_quarterSteps = 0;
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+volatile int16_t RotaryEncoder<PinA, PinB, SwitchPin>::_steps = 0;
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+volatile int16_t RotaryEncoder<PinA, PinB, SwitchPin>::_accelSteps = 0;
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+volatile uint32_t RotaryEncoder<PinA, PinB, SwitchPin>::_lastStepTime = 0;
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+volatile uint16_t RotaryEncoder<PinA, PinB, SwitchPin>::_stepInterval = 0;
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+bool RotaryEncoder<PinA, PinB, SwitchPin>::begin()
+{
+	beginAsync();
+
+	// Need to wait some time before setting up the ISRs, otherwise you can get spurious
+	// changes as the pullup hasn't quite done its magic yet.
+	delay(BUTTON_SETTLE_DELAY);
+	arm();
+	return true;
+}
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+bool RotaryEncoder<PinA, PinB, SwitchPin>::beginAsync()
+{
+	// If the encoder has already been started, kill it before restarting it.
+	stop();
+
+	pinMode(PinA, INPUT_PULLUP);
+	pinMode(PinB, INPUT_PULLUP);
+	if (HasSwitch) pinMode(SwitchPin, INPUT_PULLUP);
+
+	Base::startArming();
+	return true;
+}
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+void RotaryEncoder<PinA, PinB, SwitchPin>::arm()
+{
+	attachInterrupt(ButtonPin<PinA>::interruptNumber(), &RotaryEncoder::encoder_ISR, CHANGE);
+	attachInterrupt(ButtonPin<PinB>::interruptNumber(), &RotaryEncoder::encoder_ISR, CHANGE);
+	if (HasSwitch) attachInterrupt(ButtonPin<SwitchPin>::interruptNumber(), &RotaryEncoder::button_ISR, CHANGE);
+
+	ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+	_state = readState();
+	_quarterSteps = 0;
+	_steps = 0;
+	_accelSteps = 0;
+	buttonsRestoreInterrupts(interruptState);
+	Base::reset(0, polledDown(0), BUTTONS_NOW());
+
+	Base::armed();
+}
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+void RotaryEncoder<PinA, PinB, SwitchPin>::stop()
+{
+	// A start still waiting for the pull-ups to settle has no interrupts to detach,
+	// and if the object is already stopped, we don't need to do anything.
+	if (!Base::stopping())
+		return;
+
+	detachInterrupt(ButtonPin<PinA>::interruptNumber());
+	detachInterrupt(ButtonPin<PinB>::interruptNumber());
+	if (HasSwitch) detachInterrupt(ButtonPin<SwitchPin>::interruptNumber());
+}
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+void RotaryEncoder<PinA, PinB, SwitchPin>::encoder_ISR()
+{
+	// Direction of each (previous << 2 | current) transition; 0 for no change or a skipped state.
+	static const int8_t transitions[16] = { 0, -1, 1, 0, 1, 0, 0, -1, -1, 0, 0, 1, 0, 1, -1, 0 };
+	// Position of each Gray code state along the cycle 00 -> 01 -> 11 -> 10, with the rest state 11 at 0.
+	static const uint8_t positions[4] = { 2, 3, 1, 0 };
+
+	uint8_t state = readState();
+	int8_t quarterSteps = _quarterSteps + transitions[(_state << 2) | state];
+	_state = state;
+
+	if (positions[state] % ENCODER_STEPS_PER_DETENT != 0)
+	{
+		_quarterSteps = quarterSteps;
+		return;
+	}
+
+	// A detent position: emit a step if we got here mostly moving one way.
+	_quarterSteps = 0;
+	int8_t direction;
+	if (2 * quarterSteps >= ENCODER_STEPS_PER_DETENT)
+		direction = 1;
+	else if (2 * quarterSteps <= -ENCODER_STEPS_PER_DETENT)
+		direction = -1;
+	else
+		return;
+
+	uint32_t now = millis();
+	uint32_t interval = now - _lastStepTime;
+	_lastStepTime = now;
+	_stepInterval = interval > 0xFFFF ? 0xFFFF : interval;
+
+	uint8_t weight = 1;
+	if (interval < ENCODER_ACCEL_INTERVAL)
+		weight += (uint16_t)(ENCODER_ACCEL_INTERVAL - interval) * (ENCODER_ACCEL_MAX - 1) / ENCODER_ACCEL_INTERVAL;
+
+	_steps = _steps + direction;
+	_accelSteps = _accelSteps + direction * weight;
+	Base::raiseEvent(0, direction > 0 ? ButtonState::STEP_UP_FLAG : ButtonState::STEP_DOWN_FLAG, BUTTONS_NOW(), 0);
+}
+
+template <uint8_t PinA, uint8_t PinB, uint8_t SwitchPin>
+void RotaryEncoder<PinA, PinB, SwitchPin>::button_ISR()
+{
+	Base::updateButton(0, polledDown(0), BUTTONS_NOW());
+}
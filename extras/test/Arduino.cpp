@@ -0,0 +1,193 @@
+#include <Arduino.h>
+
+static unsigned long _micros = 0;
+static bool _enabled = true;
+static unsigned long _interruptCount = 0;
+static uint8_t _levels[MOCK_PIN_COUNT];
+static void (*_handlers[MOCK_PIN_COUNT])();
+static bool _pending[MOCK_PIN_COUNT];
+
+struct ScheduledEdge
+{
+	unsigned long at;
+	uint8_t pin;
+	bool down;
+};
+
+static const uint8_t MAX_EDGES = 64;
+static ScheduledEdge _edges[MAX_EDGES];
+static uint8_t _edgeCount = 0;
+
+#ifdef __AVR_ATmega328P__
+volatile uint8_t PIND, PINB, PINC, PCMSK0, PCMSK1, PCMSK2, PCICR;
+MockFlagRegister PCIFR;
+
+// Overridden by the ISR() definitions of buttonsPcint.h.
+extern "C" __attribute__((weak)) void PCINT0_vect() {}
+extern "C" __attribute__((weak)) void PCINT1_vect() {}
+extern "C" __attribute__((weak)) void PCINT2_vect() {}
+
+static const uint8_t INTERRUPT_PINS[] = { 2, 3 };
+
+// Sets the port bit of a pin, and the pin change flag of its group if the pin is enabled.
+static void setPortBit(uint8_t pin, bool high)
+{
+	volatile uint8_t& port = pin < 8 ? PIND : (pin < 14 ? PINB : PINC);
+	volatile uint8_t& mask = pin < 8 ? PCMSK2 : (pin < 14 ? PCMSK0 : PCMSK1);
+	uint8_t group = pin < 8 ? PCIF2 : (pin < 14 ? PCIF0 : PCIF1);
+	uint8_t bit = _BV(pin < 8 ? pin : (pin < 14 ? pin - 8 : pin - 14));
+	if (pin >= 20 || ((port & bit) != 0) == high) return;
+
+	port = high ? (port | bit) : (port & ~bit);
+	if (mask & bit) PCIFR.bits = PCIFR.bits | _BV(group);
+}
+#endif
+
+// Runs an interrupt handler with interrupts disabled, as the hardware does.
+static void runHandler(void (*handler)())
+{
+	_enabled = false;
+	_interruptCount++;
+	handler();
+	_enabled = true;
+}
+
+static void serviceInterrupts()
+{
+	for (uint8_t pin = 0; pin < MOCK_PIN_COUNT; pin++)
+	{
+		if (!_pending[pin]) continue;
+		_pending[pin] = false;
+		if (_handlers[pin] != nullptr) runHandler(_handlers[pin]);
+	}
+#ifdef __AVR_ATmega328P__
+	static void (*const vectors[])() = { &PCINT0_vect, &PCINT1_vect, &PCINT2_vect };
+	for (uint8_t group = 0; group < 3; group++)
+	{
+		if ((PCIFR & _BV(group)) == 0 || (PCICR & _BV(group)) == 0) continue;
+		PCIFR.bits = PCIFR.bits & ~_BV(group);
+		runHandler(vectors[group]);
+	}
+#endif
+}
+
+unsigned long millis() { return _micros / 1000; }
+unsigned long micros() { return _micros; }
+void delay(unsigned long ms) { mockAdvance(ms); }
+void pinMode(uint8_t, uint8_t) {}
+int digitalRead(uint8_t pin) { return _levels[pin]; }
+
+void attachInterrupt(uint8_t interruptNumber, void (*isr)(), int)
+{
+	// Like the Arduino cores, an unknown interrupt number (NOT_AN_INTERRUPT) is ignored.
+#ifdef __AVR_ATmega328P__
+	if (interruptNumber < sizeof(INTERRUPT_PINS)) _handlers[INTERRUPT_PINS[interruptNumber]] = isr;
+#else
+	if (interruptNumber < MOCK_PIN_COUNT) _handlers[interruptNumber] = isr;
+#endif
+}
+
+void detachInterrupt(uint8_t interruptNumber)
+{
+	attachInterrupt(interruptNumber, nullptr, CHANGE);
+}
+
+void interrupts()
+{
+	_enabled = true;
+	serviceInterrupts();
+}
+
+void noInterrupts() { _enabled = false; }
+
+uint32_t mockSaveInterrupts()
+{
+	bool enabled = _enabled;
+	_enabled = false;
+	return enabled;
+}
+
+void mockRestoreInterrupts(uint32_t enabled)
+{
+	if (enabled) interrupts();
+}
+
+void mockReset(unsigned long start)
+{
+	_micros = start * 1000;
+	_enabled = true;
+	_edgeCount = 0;
+	for (uint8_t pin = 0; pin < MOCK_PIN_COUNT; pin++)
+	{
+		_levels[pin] = HIGH;
+		_handlers[pin] = nullptr;
+		_pending[pin] = false;
+	}
+#ifdef __AVR_ATmega328P__
+	PIND = PINB = PINC = 0xFF;
+	PCMSK0 = PCMSK1 = PCMSK2 = PCICR = PCIFR.bits = 0;
+#endif
+}
+
+void mockSetPin(uint8_t pin, bool down)
+{
+	uint8_t level = down ? LOW : HIGH;
+	if (_levels[pin] == level) return;
+
+	_levels[pin] = level;
+	_pending[pin] = true;
+#ifdef __AVR_ATmega328P__
+	setPortBit(pin, !down);
+#endif
+	if (_enabled) serviceInterrupts();
+}
+
+void mockSchedulePin(unsigned long at, uint8_t pin, bool down)
+{
+	if (_edgeCount < MAX_EDGES) _edges[_edgeCount++] = { at, pin, down };
+}
+
+// Index of the earliest scheduled edge, or MAX_EDGES if there is none.
+static uint8_t nextEdge()
+{
+	uint8_t next = MAX_EDGES;
+	for (uint8_t i = 0; i < _edgeCount; i++)
+	{
+		if (next == MAX_EDGES || _edges[i].at < _edges[next].at) next = i;
+	}
+	return next;
+}
+
+static void applyEdge(uint8_t i)
+{
+	ScheduledEdge edge = _edges[i];
+	_edges[i] = _edges[--_edgeCount];
+	if (edge.at * 1000 > _micros) _micros = edge.at * 1000;
+	mockSetPin(edge.pin, edge.down);
+}
+
+void mockAdvanceMicros(unsigned long us)
+{
+	unsigned long end = _micros + us;
+	for (uint8_t i = nextEdge(); i != MAX_EDGES && _edges[i].at * 1000 <= end; i = nextEdge())
+		applyEdge(i);
+	_micros = end;
+}
+
+void mockAdvance(unsigned long ms)
+{
+	mockAdvanceMicros(ms * 1000);
+}
+
+void mockSleep()
+{
+	uint8_t i = nextEdge();
+	if (i == MAX_EDGES)
+		_micros += 1000;
+	else
+		applyEdge(i);
+}
+
+bool mockInterruptsEnabled() { return _enabled; }
+
+unsigned long mockInterruptCount() { return _interruptCount; }
@@ -0,0 +1,90 @@
+/*
+ *  Arduino Buttons Template Library - Host test stand-in for the Arduino core
+ *  Only what the library uses: time moves when a test advances it, pins are driven by the test,
+ *  and interrupts run synchronously, at once when enabled or when interrupts() re-enables them.
+ *  Defining __AVR_ATmega328P__ adds the port and pin change registers of that chip.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define NOT_AN_INTERRUPT 255
+#define _BV(bit) (1 << (bit))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interruptNumber, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interruptNumber);
+void interrupts();
+void noInterrupts();
+
+#ifdef __AVR_ATmega328P__
+// External interrupts only on D2 (INT0) and D3 (INT1); the other pins use pin change interrupts.
+#define digitalPinToInterrupt(pin) ((pin) == 2 ? 0 : ((pin) == 3 ? 1 : NOT_AN_INTERRUPT))
+extern volatile uint8_t PIND, PINB, PINC, PCMSK0, PCMSK1, PCMSK2, PCICR;
+// Like on the chip, writing a one to a PCIFR flag clears it (so PCIFR |= x clears every raised flag);
+// the flags are raised by the pin changes of the stand-in, and cleared when their vector runs.
+struct MockFlagRegister
+{
+	volatile uint8_t bits;
+	operator uint8_t() const { return bits; }
+	MockFlagRegister& operator=(uint8_t ones) { bits = bits & ~ones; return *this; }
+	MockFlagRegister& operator|=(uint8_t value) { return *this = bits | value; }
+	MockFlagRegister& operator&=(uint8_t value) { return *this = bits & value; }
+};
+extern MockFlagRegister PCIFR;
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+#define A0 14
+#define ISR(vector) extern "C" void vector()
+extern "C" void PCINT0_vect();
+extern "C" void PCINT1_vect();
+extern "C" void PCINT2_vect();
+#else
+#define digitalPinToInterrupt(pin) (pin)
+#endif
+
+/**
+* Test controls. Pins are numbered 0 to MOCK_PIN_COUNT - 1 and idle HIGH (pulled up).
+*/
+#define MOCK_PIN_COUNT 32
+
+// Starts over at time 0 (or start, in ms) with every pin high and no interrupt attached.
+void mockReset(unsigned long start = 0);
+// Moves the clock forward, applying the pin edges scheduled on the way at their own time.
+void mockAdvance(unsigned long ms);
+void mockAdvanceMicros(unsigned long us);
+// Drives a pin low (down) or high now, and runs or pends its interrupts.
+void mockSetPin(uint8_t pin, bool down);
+// Schedules mockSetPin(pin, down) at the absolute time at (ms).
+void mockSchedulePin(unsigned long at, uint8_t pin, bool down);
+// Stands in for WFI with interrupts disabled: the clock runs to the next scheduled edge, or for
+// one millisecond tick if there is none, and returns with the interrupt pending.
+void mockSleep();
+bool mockInterruptsEnabled();
+// Number of times interrupt handlers have been run.
+unsigned long mockInterruptCount();
+
+// Interrupt state saved and restored by the library's critical sections.
+uint32_t mockSaveInterrupts();
+void mockRestoreInterrupts(uint32_t enabled);
+#define BUTTONS_SAVE_INTERRUPTS() mockSaveInterrupts()
+#define BUTTONS_RESTORE_INTERRUPTS(state) mockRestoreInterrupts(state)
+
+// Sleep of the host builds, in the shape of the ARM default: wait, then let the interrupt run.
+#ifndef BUTTONS_ENTER_SLEEP
+#define BUTTONS_ENTER_SLEEP() do { mockSleep(); interrupts(); noInterrupts(); } while (0)
+#endif
@@ -0,0 +1,51 @@
+#include <EEPROM.h>
+#include <stdio.h>
+#include <string.h>
+
+EEPROMClass EEPROM;
+
+static uint8_t _cells[MOCK_EEPROM_SIZE];
+static FILE* _file = nullptr;
+
+bool mockEepromOpen(const char* path)
+{
+	if (_file != nullptr) fclose(_file);
+	memset(_cells, 0xFF, sizeof(_cells));
+	_file = fopen(path, "r+b");
+	if (_file != nullptr)
+	{
+		size_t read = fread(_cells, 1, sizeof(_cells), _file);
+		(void)read;
+		return true;
+	}
+	_file = fopen(path, "w+b");
+	if (_file == nullptr) return false;
+	fwrite(_cells, 1, sizeof(_cells), _file);
+	fflush(_file);
+	return true;
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+	if (address < 0 || address >= MOCK_EEPROM_SIZE) return;
+	_cells[address] = value;
+	if (_file == nullptr) return;
+	fseek(_file, address, SEEK_SET);
+	fputc(value, _file);
+	fflush(_file);
+}
+
+uint8_t EEPROMClass::read(int address)
+{
+	return address >= 0 && address < MOCK_EEPROM_SIZE ? _cells[address] : 0xFF;
+}
+
+void EEPROMClass::update(int address, uint8_t value)
+{
+	if (read(address) != value) write(address, value);
+}
+
+void mockEepromFlip(int address, uint8_t bit)
+{
+	EEPROM.write(address, EEPROM.read(address) ^ (1 << bit));
+}
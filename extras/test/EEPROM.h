@@ -0,0 +1,43 @@
+/*
+ *  Arduino Buttons Template Library - Host test stand-in for the EEPROM library
+ *  The AVR EEPROM API, backed by a file so that a test can reopen it as after a power cycle.
+ *  Cells of a new file read as erased (0xFF), and every write goes through to the file.
+ */
+
+#pragma once
+#include <stdint.h>
+
+#define MOCK_EEPROM_SIZE 1024
+
+// Loads the EEPROM from the file at path, creating it erased if it does not exist.
+bool mockEepromOpen(const char* path);
+// Flips one bit of a cell in the file and in memory, as a corrupted write would.
+void mockEepromFlip(int address, uint8_t bit);
+
+struct EEPROMClass
+{
+	uint8_t read(int address);
+	void write(int address, uint8_t value);
+	void update(int address, uint8_t value);
+	uint16_t length() { return MOCK_EEPROM_SIZE; }
+
+	template <class T>
+	T& get(int address, T& value)
+	{
+		uint8_t* bytes = (uint8_t*)&value;
+		for (unsigned i = 0; i < sizeof(T); i++)
+			bytes[i] = read(address + i);
+		return value;
+	}
+
+	template <class T>
+	const T& put(int address, const T& value)
+	{
+		const uint8_t* bytes = (const uint8_t*)&value;
+		for (unsigned i = 0; i < sizeof(T); i++)
+			update(address + i, bytes[i]);
+		return value;
+	}
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,9 @@
+// Must not compile: pin 4 of the ATmega328P has no external interrupt (run.sh checks the message).
+#include <buttonsTemplate.h>
+#include <encoderTemplate.h>
+
+#ifdef ENCODER
+template class RotaryEncoder<2, 3, 4>;
+#else
+template class StaticButtons<2, 4>;
+#endif
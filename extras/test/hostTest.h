@@ -0,0 +1,26 @@
+/*
+ *  Arduino Buttons Template Library - Host test helpers
+ */
+
+#pragma once
+#include <stdio.h>
+
+static int hostFailures = 0;
+
+#define CHECK(condition) hostCheck((condition), #condition, __FILE__, __LINE__)
+
+inline void hostCheck(bool passed, const char* condition, const char* file, int line)
+{
+	if (passed) return;
+	fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, condition);
+	hostFailures++;
+}
+
+/**
+* Prints the outcome of a test program; return it from main().
+*/
+inline int hostTestResult(const char* name)
+{
+	printf("%s: %s\n", name, hostFailures == 0 ? "passed" : "FAILED");
+	return hostFailures == 0 ? 0 : 1;
+}
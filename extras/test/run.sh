@@ -0,0 +1,39 @@
+#!/bin/sh
+# Builds and runs the host tests with the stand-in Arduino core of this folder.
+# Usage: extras/test/run.sh [test names...]; CXX and CXXFLAGS select the compiler and options.
+# Each test gets the scratch folder as argument, for the files it writes.
+set -e
+cd "$(dirname "$0")"
+CXX=${CXX:-g++}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+FLAGS="-Wall -Wextra -Werror -I. -I../.. -I../../single $CXXFLAGS"
+
+build() {
+	name=$1
+	shift
+	$CXX $FLAGS "$@" -o "$OUT/$name"
+	"$OUT/$name" "$OUT"
+}
+
+test_coroutine() { build coroutine -std=c++20 test_coroutine.cpp Arduino.cpp; }
+test_sleep() { build sleep -std=c++11 test_sleep.cpp Arduino.cpp; }
+test_encoder() { build encoder -std=c++11 test_encoder.cpp Arduino.cpp; }
+test_packed() { build packed -std=c++11 test_packed.cpp Arduino.cpp; }
+test_single() { build single -std=c++11 test_single.cpp ../../single/buttonsSingle.cpp Arduino.cpp; }
+test_config() { build config -std=c++11 test_config.cpp EEPROM.cpp Arduino.cpp; }
+test_queue() { build queue -std=c++11 -pthread test_queue.cpp Arduino.cpp; }
+test_pcint() { build pcint -std=c++11 -D__AVR_ATmega328P__ test_pcint.cpp test_pcint_other.cpp Arduino.cpp; }
+
+# Pins without an external interrupt must be rejected at compile time, pointing to PcintButtons.
+rejects() {
+	$CXX $FLAGS -std=c++11 -D__AVR_ATmega328P__ -fsyntax-only "$@" fail_nointerrupt.cpp 2>&1 | grep -q "use PcintButtons"
+}
+test_nointerrupt() {
+	if rejects && rejects -DENCODER; then echo "nointerrupt: passed"; else echo "nointerrupt: FAILED"; return 1; fi
+}
+
+TESTS=${*:-"coroutine sleep encoder packed single config queue pcint nointerrupt"}
+for t in $TESTS; do
+	"test_$t"
+done
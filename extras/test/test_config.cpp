@@ -0,0 +1,115 @@
+// ButtonsConfig: saveConfig()/loadConfig()/beginFromConfig() round trip through a file-backed EEPROM, and corruption checks.
+#include <buttonsTemplate.h>
+#include <EEPROM.h>
+#include <string.h>
+#include <string>
+#include "hostTest.h"
+
+using buttons = Buttons<2>;
+using fixed = StaticButtons<6, 7, 8>;
+static const uint8_t defaultPins[] = { 4, 5 };
+static const uint8_t tunedPins[] = { 9, 10 };
+
+typedef uint8_t Config[ButtonsConfig::size(2)];
+
+// What a sketch does at startup: the stored blob if it is valid, else the defaults.
+static bool startFromEeprom()
+{
+	Config config;
+	EEPROM.get(0, config);
+	if (buttons::beginFromConfig(config, sizeof(config))) return true;
+	buttons::begin(defaultPins);
+	return false;
+}
+
+// Presses pin for ms and returns true if it was classified as a long release.
+static bool longPress(uint8_t pin, unsigned long ms)
+{
+	mockAdvance(DOUBLE_CLICK_DELAY + 1);
+	buttons::longReleased(pin == buttons::pin(0) ? 0 : 1);
+	mockSetPin(pin, true);
+	mockAdvance(ms);
+	mockSetPin(pin, false);
+	return buttons::longReleased(pin == buttons::pin(0) ? 0 : 1);
+}
+
+int main(int argc, char* argv[])
+{
+	std::string path = std::string(argc > 1 ? argv[1] : ".") + "/eeprom.bin";
+	remove(path.c_str());
+	mockReset(1000);
+
+	// CRC-16/CCITT-FALSE check value.
+	CHECK(ButtonsConfig::crc16((const uint8_t*)"123456789", 9) == 0x29B1);
+
+	// A blank EEPROM is not a valid blob: the defaults are used.
+	CHECK(mockEepromOpen(path.c_str()));
+	CHECK(!startFromEeprom());
+	CHECK(buttons::pin(0) == 4 && buttons::pin(1) == 5);
+	CHECK(!longPress(4, 600));
+
+	// Retune, save, and come back from a power cycle with the stored pins and periods.
+	CHECK(buttons::begin(tunedPins));
+	buttons::setLongReleaseDelay(400);
+	buttons::setDoubleClickDelay(300);
+	Config saved;
+	CHECK(buttons::saveConfig(saved, sizeof(saved) - 1) == 0);
+	CHECK(buttons::saveConfig(saved, sizeof(saved)) == sizeof(saved));
+	CHECK(saved[0] == 'B' && saved[1] == 'T' && saved[2] == ButtonsConfig::VERSION);
+	CHECK(ButtonsConfig::read16(saved + 3) == 2 && ButtonsConfig::read16(saved + 9) == 400);
+	EEPROM.put(0, saved);
+
+	buttons::stop();
+	buttons::setLongReleaseDelay(LONG_RELEASE_DELAY);
+	buttons::setDoubleClickDelay(DOUBLE_CLICK_DELAY);
+	CHECK(mockEepromOpen(path.c_str()));
+	CHECK(startFromEeprom());
+	CHECK(buttons::pin(0) == 9 && buttons::pin(1) == 10);
+	CHECK(longPress(10, 600));
+	Config reloaded;
+	CHECK(buttons::saveConfig(reloaded, sizeof(reloaded)) == sizeof(reloaded));
+	CHECK(memcmp(saved, reloaded, sizeof(saved)) == 0);
+
+	// Any single bit flipped anywhere in the stored blob is rejected, changing nothing.
+	buttons::setLongReleaseDelay(700);
+	for (uint16_t i = 0; i < sizeof(Config); i++)
+	{
+		for (uint8_t bit = 0; bit < 8; bit++)
+		{
+			mockEepromFlip(i, bit);
+			CHECK(mockEepromOpen(path.c_str()));
+			Config config;
+			EEPROM.get(0, config);
+			CHECK(!buttons::loadConfig(config, sizeof(config)));
+			mockEepromFlip(i, bit);
+		}
+	}
+	CHECK(buttons::saveConfig(reloaded, sizeof(reloaded)) == sizeof(reloaded));
+	CHECK(ButtonsConfig::read16(reloaded + 9) == 700);
+
+	// A period that does not fit in the blob is not saved truncated.
+	buttons::setLongReleaseDelay(70000);
+	CHECK(buttons::saveConfig(reloaded, sizeof(reloaded)) == 0);
+	buttons::setLongReleaseDelay(ButtonsConfig::MAX_PERIOD);
+	CHECK(buttons::saveConfig(reloaded, sizeof(reloaded)) == sizeof(reloaded));
+	CHECK(ButtonsConfig::read16(reloaded + 9) == ButtonsConfig::MAX_PERIOD);
+
+	// A blob that is too short, or made for another number of buttons, is rejected too.
+	CHECK(!buttons::loadConfig(saved, sizeof(saved) - 1));
+	CHECK(!buttons::loadConfig(nullptr, sizeof(saved)));
+	CHECK(!fixed::loadConfig(saved, sizeof(saved)));
+
+	// The classes with compile-time pins store their pins, and only take the periods back.
+	uint8_t fixedConfig[ButtonsConfig::size(3)];
+	CHECK(fixed::saveConfig(fixedConfig, sizeof(fixedConfig)) == sizeof(fixedConfig));
+	CHECK(ButtonsConfig::pins(fixedConfig)[2] == 8);
+	ButtonsConfig::write16(fixedConfig + 5, 12);
+	CHECK(!fixed::loadConfig(fixedConfig, sizeof(fixedConfig)));
+	ButtonsConfig::seal(fixedConfig, 3);
+	CHECK(fixed::loadConfig(fixedConfig, sizeof(fixedConfig)));
+	CHECK(fixed::saveConfig(fixedConfig, sizeof(fixedConfig)) == sizeof(fixedConfig));
+	CHECK(ButtonsConfig::read16(fixedConfig + 5) == 12);
+
+	remove(path.c_str());
+	return hostTestResult("config");
+}
@@ -0,0 +1,169 @@
+// ButtonsAwait and ButtonTask (C++20): awaits resumed by dispatch(), timeouts, encoder detents, and the frame pool.
+#include <buttonsCoroutine.h>
+#include <encoderTemplate.h>
+#include "hostTest.h"
+
+using buttons = StaticButtons<2, 3>;
+using buttonsAwait = ButtonsAwait<buttons>;
+
+static uint8_t stage = 0;
+static ButtonEventInfo events[4];
+
+static ButtonTask flow()
+{
+	events[0] = co_await buttonsAwait::pressed(0);
+	stage = 1;
+	events[1] = co_await buttonsAwait::released(0);
+	stage = 2;
+	events[2] = co_await buttonsAwait::anyEvent(100);
+	stage = 3;
+	events[3] = co_await buttonsAwait::doubleClicked(1);
+	stage = 4;
+}
+
+using encoder = RotaryEncoder<6, 7>;
+using encoderAwait = ButtonsAwait<encoder>;
+
+static ButtonEventInfo rotation[2];
+
+static ButtonTask turns()
+{
+	rotation[0] = co_await encoderAwait::rotated();
+	rotation[1] = co_await encoderAwait::anyEvent();
+}
+
+static void turn(bool up)
+{
+	uint8_t first = up ? 6 : 7, second = up ? 7 : 6;
+	mockSetPin(first, true);
+	mockSetPin(second, true);
+	mockSetPin(first, false);
+	mockSetPin(second, false);
+}
+
+// A press of the same button landing right after the flag is taken, 50 ms after the release.
+struct PressAfterTake
+{
+	static bool update() { return buttons::update(); }
+	static bool eventPending() { return buttons::eventPending(); }
+	static uint16_t numberOfButtons() { return buttons::numberOfButtons(); }
+
+	static bool take(uint8_t buttonId, uint8_t flag, ButtonState::Times& times)
+	{
+		bool taken = buttons::take(buttonId, flag, times);
+		if (taken)
+		{
+			mockAdvance(50);
+			mockSetPin(2, true);
+		}
+		return taken;
+	}
+};
+
+static ButtonEventInfo release;
+
+static ButtonTask releasedOnce()
+{
+	release = co_await ButtonsAwait<PressAfterTake>::released(0);
+}
+
+static ButtonTask waitForever()
+{
+	co_await buttonsAwait::longReleased(1);
+}
+
+static ButtonTask tooLarge()
+{
+	volatile uint8_t scratch[BUTTON_TASK_FRAME_SIZE];
+	scratch[0] = 0;
+	co_await buttonsAwait::clicked(0);
+	scratch[1] = scratch[0];
+}
+
+static void press(uint8_t pin, unsigned long ms)
+{
+	mockSetPin(pin, true);
+	mockAdvance(ms);
+	mockSetPin(pin, false);
+}
+
+int main()
+{
+	mockReset(1000);
+	CHECK(buttons::begin());
+
+	CHECK(flow().started());
+	CHECK(stage == 0);
+	buttonsAwait::dispatch();
+	CHECK(stage == 0);
+
+	// Past the double click window that begin() opens.
+	mockAdvance(600);
+	mockSetPin(2, true);
+	buttonsAwait::dispatch();
+	CHECK(stage == 1);
+	CHECK(events[0].buttonId == 0 && events[0].event == ButtonEvent::Clicked);
+	CHECK(events[0].time == 1610);
+
+	mockAdvance(300);
+	mockSetPin(2, false);
+	buttonsAwait::dispatch();
+	CHECK(stage == 2);
+	CHECK(events[1].event == ButtonEvent::ShortReleased && events[1].duration == 300);
+
+	// Nothing happens within 100 ms: the waiter is resumed with a timeout.
+	mockAdvance(99);
+	buttonsAwait::dispatch();
+	CHECK(stage == 2);
+	mockAdvance(1);
+	buttonsAwait::dispatch();
+	CHECK(stage == 3);
+	CHECK(events[2].event == ButtonEvent::Timeout && events[2].buttonId == ButtonEventInfo::NO_BUTTON);
+
+	// A single click on button 1 does not match a doubleClicked() waiter.
+	mockAdvance(600);
+	press(3, 50);
+	buttonsAwait::dispatch();
+	CHECK(stage == 3);
+	mockAdvance(100);
+	press(3, 50);
+	buttonsAwait::dispatch();
+	CHECK(stage == 4);
+	CHECK(events[3].buttonId == 1 && events[3].event == ButtonEvent::DoubleClicked);
+
+	// Encoder detents resume rotated() and anyEvent() waiters, with the steps turned.
+	CHECK(encoder::begin());
+	CHECK(turns().started());
+	turn(true);
+	turn(true);
+	encoderAwait::dispatch();
+	CHECK(rotation[0].event == ButtonEvent::Rotated && rotation[0].steps == 2);
+	CHECK(rotation[0].time == millis());
+	encoderAwait::dispatch();
+	CHECK(rotation[1].event == ButtonEvent::None);
+	turn(false);
+	encoderAwait::dispatch();
+	CHECK(rotation[1].event == ButtonEvent::Rotated && rotation[1].steps == -1);
+
+	// The duration and time reported are those of the press that raised the flag.
+	CHECK(releasedOnce().started());
+	mockAdvance(600);
+	press(2, 300);
+	unsigned long releasedAt = millis();
+	ButtonsAwait<PressAfterTake>::dispatch();
+	CHECK(release.event == ButtonEvent::ShortReleased && release.duration == 300);
+	CHECK(release.time == releasedAt);
+	mockSetPin(2, false);
+
+	// The frames of finished coroutines go back to the pool; a full pool refuses new ones.
+	for (uint8_t i = 0; i < BUTTON_TASK_POOL_SIZE; i++)
+		CHECK(waitForever().started());
+	CHECK(!waitForever().started());
+	CHECK(ButtonTask::frameSizeNeeded() <= BUTTON_TASK_FRAME_SIZE);
+
+	// A frame larger than the pool slots is refused, and its size is reported.
+	CHECK(!tooLarge().started());
+	CHECK(ButtonTask::frameSizeNeeded() > BUTTON_TASK_FRAME_SIZE);
+
+	return hostTestResult("coroutine");
+}
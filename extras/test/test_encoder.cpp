@@ -0,0 +1,105 @@
+// RotaryEncoder: detent decoding, bounce tolerance, acceleration, and detents reported to the event handler.
+#include <encoderTemplate.h>
+#include "hostTest.h"
+
+using encoder = RotaryEncoder<6, 7, 8>;
+
+static int16_t handlerSteps = 0;
+static uint8_t handlerClicks = 0;
+static unsigned long handlerTime = 0;
+static unsigned long handlerDuration = 0;
+
+static void onEvent(uint16_t buttonId, uint8_t flag, unsigned long time, unsigned long duration)
+{
+	CHECK(buttonId == 0);
+	if (flag == ButtonState::STEP_UP_FLAG) handlerSteps++;
+	else if (flag == ButtonState::STEP_DOWN_FLAG) handlerSteps--;
+	else if (flag == ButtonState::CLICKED_FLAG) handlerClicks++;
+	handlerTime = time;
+	handlerDuration = duration;
+	// Handlers run in interrupt context: the accessors must not enable the interrupts.
+	encoder::pressDuration(0);
+	encoder::lastStepTime();
+	CHECK(!mockInterruptsEnabled());
+}
+
+// One detent: A leads B when turning up. Each quarter step is ms apart.
+static void turn(bool up, unsigned long ms)
+{
+	uint8_t first = up ? 6 : 7, second = up ? 7 : 6;
+	mockSetPin(first, true);
+	mockAdvance(ms);
+	mockSetPin(second, true);
+	mockAdvance(ms);
+	mockSetPin(first, false);
+	mockAdvance(ms);
+	mockSetPin(second, false);
+	mockAdvance(ms);
+}
+
+int main()
+{
+	mockReset(1000);
+	CHECK(encoder::begin());
+	encoder::setEventHandler(&onEvent);
+
+	turn(true, 50);
+	turn(true, 50);
+	turn(false, 50);
+	CHECK(encoder::eventPending());
+	CHECK(encoder::read() == 1);
+	CHECK(encoder::read() == 0);
+	CHECK(handlerSteps == 1);
+	CHECK(handlerTime == millis() - 50);
+	CHECK(handlerDuration == 0);
+	CHECK(encoder::lastStepTime() == millis() - 50);
+
+	// Contact bounce on A before B moves: no step, and the detent alignment is kept.
+	mockSetPin(6, true);
+	mockSetPin(6, false);
+	mockSetPin(6, true);
+	mockSetPin(6, false);
+	CHECK(encoder::read() == 0);
+	turn(true, 50);
+	CHECK(encoder::read() == 1);
+
+	// Half a detent and back is no step.
+	mockSetPin(6, true);
+	mockSetPin(7, true);
+	mockSetPin(7, false);
+	mockSetPin(6, false);
+	CHECK(encoder::read() == 0);
+
+	// Fast steps count more in readAccelerated().
+	encoder::readAccelerated();
+	mockAdvance(1000);
+	for (uint8_t i = 0; i < 5; i++)
+		turn(true, 1);
+	CHECK(encoder::read() == 5);
+	CHECK(encoder::readAccelerated() > 5);
+	CHECK(encoder::stepsPerSecond() == 250);
+
+	// The switch is button 0 of the usual accessors, and also reported to the handler.
+	mockAdvance(1000);
+	mockSetPin(8, true);
+	CHECK(encoder::clicked(0));
+	CHECK(handlerClicks == 1);
+	mockAdvance(300);
+	mockSetPin(8, false);
+	CHECK(encoder::shortReleased(0));
+	CHECK(handlerTime == millis() && handlerDuration == 300);
+
+	// Nor end a critical section of the caller.
+	noInterrupts();
+	encoder::read();
+	encoder::pressTime(0);
+	CHECK(!mockInterruptsEnabled());
+	interrupts();
+
+	encoder::setEventHandler(nullptr);
+	turn(false, 50);
+	CHECK(encoder::read() == -1);
+	CHECK(handlerSteps == 7);
+
+	return hostTestResult("encoder");
+}
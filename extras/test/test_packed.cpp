@@ -0,0 +1,82 @@
+// PackedButtons: word-at-a-time debouncing, and event extraction in order with the event word cursors.
+#include <buttonsPacked.h>
+#include "hostTest.h"
+
+static bool inputs[300];
+
+template <class Panel, class Word>
+static void readInputs(Word words[])
+{
+	for (uint16_t w = 0; w < Panel::WORD_COUNT; w++)
+		words[w] = 0;
+	for (uint16_t i = 0; i < 300; i++)
+	{
+		if (inputs[i]) words[i / Panel::WORD_BITS] |= (Word)1 << (i % Panel::WORD_BITS);
+	}
+}
+
+// Reads twice PACKED_SCAN_INTERVAL apart, so that stable changes are accepted.
+template <class Panel>
+static bool settle()
+{
+	mockAdvance(PACKED_SCAN_INTERVAL);
+	Panel::scan();
+	mockAdvance(PACKED_SCAN_INTERVAL);
+	return Panel::scan();
+}
+
+template <class Panel, class Word>
+static void testPanel()
+{
+	for (uint16_t i = 0; i < 300; i++)
+		inputs[i] = false;
+	CHECK(Panel::begin(&readInputs<Panel, Word>));
+	CHECK(Panel::nextClicked() == Panel::NO_BUTTON);
+
+	// A change seen by a single scan is a bounce.
+	inputs[7] = true;
+	mockAdvance(PACKED_SCAN_INTERVAL);
+	CHECK(!Panel::scan());
+	inputs[7] = false;
+	mockAdvance(PACKED_SCAN_INTERVAL);
+	Panel::scan();
+	CHECK(Panel::nextClicked() == Panel::NO_BUTTON);
+	CHECK(Panel::up(7));
+
+	// Scans closer than PACKED_SCAN_INTERVAL do not read.
+	inputs[299] = true;
+	CHECK(!Panel::scan());
+
+	inputs[3] = inputs[150] = inputs[151] = inputs[299] = true;
+	settle<Panel>();
+	CHECK(Panel::eventPending());
+	CHECK(Panel::down(150) && Panel::up(152));
+	CHECK(Panel::nextClicked() == 3);
+	CHECK(Panel::nextClicked() == 150);
+
+	// An event raised below the cursor by a later scan is still found first.
+	inputs[0] = true;
+	settle<Panel>();
+	CHECK(Panel::nextClicked() == 0);
+	CHECK(Panel::nextClicked() == 151);
+	CHECK(Panel::clicked(299));
+	CHECK(Panel::nextClicked() == Panel::NO_BUTTON);
+	CHECK(Panel::nextReleased() == Panel::NO_BUTTON);
+
+	inputs[151] = false;
+	inputs[3] = false;
+	settle<Panel>();
+	CHECK(Panel::nextReleased() == 3);
+	CHECK(Panel::released(151));
+	CHECK(Panel::nextReleased() == Panel::NO_BUTTON);
+	CHECK(Panel::nextClicked() == Panel::NO_BUTTON);
+}
+
+int main()
+{
+	mockReset(1000);
+	testPanel<PackedButtons<300, uint8_t>, uint8_t>();
+	testPanel<PackedButtons<300, uint32_t>, uint32_t>();
+	testPanel<PackedButtons<300, uint64_t>, uint64_t>();
+	return hostTestResult("packed");
+}
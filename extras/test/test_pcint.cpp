@@ -0,0 +1,81 @@
+// PcintButtons on the simulated ATmega328P registers: pin change setup, XOR decoding of the
+// changed bits, and one handler table shared by several translation units.
+#include <buttonsPcint.h>
+#include "hostTest.h"
+
+using buttons = PcintButtons<4, 5, 9>;
+
+// Defined in test_pcint_other.cpp, which includes buttonsPcint.h with BUTTONS_PCINT_NO_VECTORS.
+bool otherBegin();
+bool otherClicked();
+void otherStop();
+
+int main()
+{
+	mockReset(1000);
+	PCMSK2 = _BV(0); // another user of the PORTD group (e.g. SoftwareSerial on D0)
+	PCMSK1 = _BV(5); // and of PORTC (A5), with its group interrupt not enabled yet
+
+	// Changes made before begin() leave stale flags: begin() clears those of its own groups
+	// only, so no vector runs when it enables them.
+	mockSetPin(0, true);
+	mockSetPin(0, false);
+	mockSetPin(A0 + 5, true);
+	CHECK(PCIFR == (_BV(PCIF1) | _BV(PCIF2)));
+	unsigned long vectors = mockInterruptCount();
+	CHECK(buttons::begin());
+	CHECK(mockInterruptCount() == vectors);
+	CHECK(PCIFR == _BV(PCIF1));
+	CHECK(!buttons::eventPending());
+	PCMSK1 = 0;
+	PCIFR = _BV(PCIF1);
+	CHECK(PCIFR == 0);
+
+	CHECK(PCMSK2 == (_BV(0) | _BV(4) | _BV(5)));
+	CHECK(PCMSK0 == _BV(1));
+	CHECK(PCICR == (_BV(PCIE0) | _BV(PCIE2)));
+
+	mockAdvance(1000);
+	mockSetPin(9, true);
+	CHECK(buttons::clicked(2));
+	CHECK(buttons::pressTime(2) == millis());
+
+	// Only the bits that changed are classified. Button 1 is pressed, then released inside
+	// the debounce period, so its debounced state stays "down" while its pin reads high...
+	mockSetPin(5, true);
+	CHECK(buttons::clicked(1));
+	mockAdvance(5);
+	mockSetPin(5, false);
+	CHECK(buttons::down(1) && !buttons::polledDown(1));
+	// ...and a change of button 0 on the same port does not reclassify it.
+	mockAdvance(1000);
+	mockSetPin(4, true);
+	CHECK(buttons::clicked(0));
+	CHECK(!buttons::shortReleased(1) && !buttons::longReleased(1));
+	CHECK(buttons::down(1));
+
+	// Pins outside the buttons do not reach the classification.
+	buttons::eventPending();
+	unsigned long interrupts = mockInterruptCount();
+	mockSetPin(0, true);
+	CHECK(mockInterruptCount() == interrupts + 1);
+	CHECK(!buttons::eventPending());
+	mockSetPin(0, false);
+
+	// A second translation unit sets its own port through the same handler table.
+	CHECK(otherBegin());
+	CHECK(PCMSK1 == _BV(0));
+	mockAdvance(1000);
+	mockSetPin(A0, true);
+	CHECK(otherClicked());
+	otherStop();
+	CHECK(PCMSK1 == 0 && (PCICR & _BV(PCIE1)) == 0);
+
+	// stop() leaves the group enabled while another pin of the port still uses it.
+	buttons::stop();
+	CHECK(PCMSK2 == _BV(0));
+	CHECK(PCICR == _BV(PCIE2));
+	CHECK(PCMSK0 == 0);
+
+	return hostTestResult("pcint");
+}
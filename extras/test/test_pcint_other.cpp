@@ -0,0 +1,9 @@
+// Second translation unit of test_pcint: the vectors are defined by the first one.
+#define BUTTONS_PCINT_NO_VECTORS
+#include <buttonsPcint.h>
+
+using otherButtons = PcintButtons<A0>;
+
+bool otherBegin() { return otherButtons::begin(); }
+bool otherClicked() { return otherButtons::clicked(0); }
+void otherStop() { otherButtons::stop(); }
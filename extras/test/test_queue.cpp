@@ -0,0 +1,183 @@
+// ButtonEventQueue and the atomic flags under real concurrency: producer threads stand in for ISRs on other cores.
+#include <buttonsQueue.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "hostTest.h"
+
+#if !BUTTONS_ATOMIC_FLAGS
+#error The queue test needs BUTTONS_ATOMIC_FLAGS
+#endif
+
+using buttons = Buttons<1>;
+using events = ButtonEventQueue<buttons, 64>;
+
+static const uint16_t PRODUCERS = 4;
+static const unsigned long EVENTS_PER_PRODUCER = 200000;
+static std::atomic<uint16_t> producersDone(0);
+
+// Each producer posts an increasing sequence number as the event time.
+static void produce(uint16_t producer)
+{
+	for (unsigned long sequence = 1; sequence <= EVENTS_PER_PRODUCER; sequence++)
+		events::post(producer, ButtonState::CLICKED_FLAG, sequence, 0);
+	producersDone++;
+}
+
+// Every event is received at most once, in the order of its producer, and every other one is counted as dropped.
+static void testQueue()
+{
+	events::begin();
+	std::thread producers[PRODUCERS];
+	for (uint16_t i = 0; i < PRODUCERS; i++)
+		producers[i] = std::thread(produce, i);
+
+	unsigned long last[PRODUCERS] = {};
+	unsigned long received = 0;
+	bool ordered = true;
+	ButtonQueuedEvent event;
+	for (;;)
+	{
+		bool done = producersDone == PRODUCERS;
+		if (events::pop(event))
+		{
+			if (event.buttonId >= PRODUCERS || event.time <= last[event.buttonId]) ordered = false;
+			else last[event.buttonId] = event.time;
+			received++;
+		}
+		else if (done)
+		{
+			break;
+		}
+	}
+	for (uint16_t i = 0; i < PRODUCERS; i++)
+		producers[i].join();
+
+	CHECK(ordered);
+	CHECK(received + events::dropped() == PRODUCERS * EVENTS_PER_PRODUCER);
+	CHECK(received > 0);
+	events::stop();
+}
+
+static volatile ButtonState state;
+static std::atomic<unsigned long> releasesTaken(0);
+static const unsigned long PRESSES = 500;
+
+// Presses and releases the button, waiting for each release to be taken before the next press
+// (a press replaces the flags, so a release not taken yet would legitimately be lost).
+static void press(std::atomic<bool>& stalled)
+{
+	ButtonTimings timings;
+	unsigned long now = 0;
+	for (unsigned long i = 1; i <= PRESSES && !stalled; i++)
+	{
+		now += 1000;
+		state.update(true, now, timings);
+		now += 1000;
+		state.update(false, now, timings);
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+		while (releasesTaken < i)
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				stalled = true;
+				break;
+			}
+			std::this_thread::yield();
+		}
+	}
+}
+
+// take() runs against update() on the other thread: no flag may be lost or taken twice.
+// The consumer spins without yielding, so that even on a single core the producer
+// preempts it at random points, inside take() as well.
+static void testFlags()
+{
+	std::atomic<bool> stalled(false);
+	std::thread producer(press, std::ref(stalled));
+	unsigned long clicks = 0;
+	while (!stalled && releasesTaken < PRESSES)
+	{
+		if (state.take(ButtonState::CLICKED_FLAG)) clicks++;
+		if (state.take(ButtonState::SHORT_RELEASED_FLAG))
+		{
+			if (state.take(ButtonState::CLICKED_FLAG)) clicks++;
+			releasesTaken++;
+		}
+	}
+	producer.join();
+
+	CHECK(!stalled);
+	CHECK(releasesTaken == PRESSES);
+	CHECK(clicks == PRESSES);
+	CHECK((state.state & ButtonState::PRESSED_FLAG) == 0);
+}
+
+static volatile ButtonState timedState;
+static const unsigned long TIMED_PRESSES = 200000;
+static std::atomic<bool> timedDone(false);
+
+// Each press lasts a duration derived from its press time, so that a press timestamp read
+// together with the release timestamp of another press shows up as a wrong duration.
+static unsigned long heldFor(unsigned long pressTime)
+{
+	return 100 + pressTime / 1000 % 400;
+}
+
+// Presses and releases without waiting for the releases to be taken.
+static void pressTimed()
+{
+	ButtonTimings timings;
+	for (unsigned long i = 1; i <= TIMED_PRESSES; i++)
+	{
+		unsigned long pressTime = i * 1000;
+		timedState.update(true, pressTime, timings);
+		timedState.update(false, pressTime + heldFor(pressTime), timings);
+	}
+	timedDone = true;
+}
+
+// take(flag, now, times) runs against update() on the other thread: the timestamps it returns
+// with a release flag always belong to the press that was released.
+static void testTimes()
+{
+	std::thread producer(pressTimed);
+	unsigned long releases = 0, clicks = 0;
+	bool matched = true;
+	for (;;)
+	{
+		bool done = timedDone;
+		ButtonState::Times times;
+		if (timedState.take(ButtonState::CLICKED_FLAG, 0, times))
+		{
+			if (times.press % 1000 != 0) matched = false;
+			clicks++;
+		}
+		static const uint8_t releaseFlags[] = { ButtonState::SHORT_RELEASED_FLAG, ButtonState::LONG_RELEASED_FLAG };
+		for (uint8_t flag : releaseFlags)
+		{
+			if (timedState.take(flag, 0, times))
+			{
+				if (times.duration != times.release - times.press || times.duration != heldFor(times.press))
+					matched = false;
+				releases++;
+			}
+		}
+		times = timedState.times(0);
+		if (times.release > times.press && times.release - times.press != heldFor(times.press)) matched = false;
+		if (done) break;
+	}
+	producer.join();
+
+	CHECK(matched);
+	CHECK(releases > 0 && clicks > 0);
+}
+
+int main()
+{
+	mockReset(1000);
+	testQueue();
+	testFlags();
+	testTimes();
+	return hostTestResult("queue");
+}
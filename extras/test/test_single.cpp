@@ -0,0 +1,91 @@
+// ButtonSingle: per-slot ISRs, arming order, events through the handler and the queue, idle time, sleep and config.
+#include <buttonsSingle.h>
+#include <buttonsQueue.h>
+#include "hostTest.h"
+
+using events = ButtonEventQueue<ButtonSingle>;
+
+static ButtonSingle first, second;
+
+int main()
+{
+	mockReset(1000);
+
+	// The slots run out at BUTTON_SINGLE_MAX_INSTANCES objects.
+	ButtonSingle extra[BUTTON_SINGLE_MAX_INSTANCES];
+	for (uint8_t i = 0; i < BUTTON_SINGLE_MAX_INSTANCES; i++)
+		CHECK(extra[i].beginAsync(10 + i));
+	CHECK(!first.begin(4));
+	for (uint8_t i = 0; i < BUTTON_SINGLE_MAX_INSTANCES; i++)
+		extra[i].stop();
+
+	// beginAsync() attaches the interrupt once the pull-up has settled.
+	CHECK(first.beginAsync(4));
+	CHECK(!first.update());
+	mockAdvance(BUTTON_SETTLE_DELAY);
+	CHECK(first.update());
+	CHECK(second.begin(5));
+	CHECK(first.msUntilIdle() == DOUBLE_CLICK_DELAY + 1 - BUTTON_SETTLE_DELAY);
+	mockAdvance(DOUBLE_CLICK_DELAY + 1);
+	CHECK(first.msUntilIdle() == 0 && second.msUntilIdle() == 0);
+
+	// Each object only sees its own pin, and reports its events to the queue with the pin as index.
+	events::begin();
+	unsigned long pressAt = millis();
+	mockSetPin(5, true);
+	CHECK(second.eventPending());
+	CHECK(!first.eventPending());
+	CHECK(second.clicked() && second.down() && first.up());
+	mockAdvance(200);
+	mockSetPin(5, false);
+	CHECK(second.shortReleased());
+	CHECK(second.pressTime() == pressAt && second.releaseTime() == pressAt + 200);
+	CHECK(second.pressDuration() == 200);
+
+	ButtonQueuedEvent event;
+	CHECK(events::pop(event));
+	CHECK(event.buttonId == 5 && event.flag == ButtonState::CLICKED_FLAG && event.time == pressAt && event.duration == 0);
+	CHECK(events::pop(event));
+	CHECK(event.buttonId == 5 && event.flag == ButtonState::SHORT_RELEASED_FLAG);
+	CHECK(event.time == pressAt + 200 && event.duration == 200);
+	CHECK(!events::pop(event));
+	events::stop();
+
+	// Sleep until a press of the first button, while the second one is idle too.
+	second.eventPending();
+	CHECK(!second.sleepUntilEvent());
+	mockAdvance(DOUBLE_CLICK_DELAY + 1);
+	pressAt = millis() + 3000;
+	mockSchedulePin(pressAt, 4, true);
+	CHECK(first.sleepUntilEvent());
+	CHECK(millis() == pressAt);
+	CHECK(first.clicked());
+	CHECK(first.msUntilIdle() == LONG_RELEASE_DELAY + 1);
+	CHECK(!first.sleepUntilEvent());
+
+	// The periods and the pin round-trip through a config blob.
+	first.setLongReleaseDelay(200);
+	uint8_t config[ButtonsConfig::size(1)];
+	CHECK(first.saveConfig(config, sizeof(config) - 1) == 0);
+	CHECK(first.saveConfig(config, sizeof(config)) == sizeof(config));
+	CHECK(!second.loadConfig(config, sizeof(config) - 1));
+	// A pin has a single interrupt handler: the first object lets it go to the second one.
+	first.stop();
+	second.stop();
+	CHECK(second.beginFromConfig(config, sizeof(config)));
+	CHECK(second.pin() == 4);
+	mockSetPin(4, false);
+	second.eventPending();
+	mockAdvance(DOUBLE_CLICK_DELAY + 1);
+	mockSetPin(4, true);
+	mockAdvance(250);
+	mockSetPin(4, false);
+	CHECK(second.longReleased());
+
+	// A press while the pin is held at arming time is captured as down.
+	mockSetPin(6, true);
+	CHECK(first.begin(6));
+	CHECK(first.down() && !first.clicked());
+
+	return hostTestResult("single");
+}
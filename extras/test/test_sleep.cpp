@@ -0,0 +1,88 @@
+// msUntilIdle() and sleepUntilEvent(): wake on a button edge, timeouts, and the timing windows across sleep.
+#include "hostTest.h"
+
+static unsigned long sleeps = 0;
+
+// The sleep of the stand-in core, checking that it is entered with interrupts masked and counted.
+#define BUTTONS_ENTER_SLEEP() do { CHECK(!mockInterruptsEnabled()); mockSleep(); sleeps++; interrupts(); noInterrupts(); } while (0)
+#include <buttonsTemplate.h>
+
+using buttons = Buttons<2>;
+static const uint8_t buttonPins[] = { 4, 5 };
+
+int main()
+{
+	mockReset(1000);
+	CHECK(buttons::begin(buttonPins));
+
+	// begin() opens a double click window: not idle, so no sleep.
+	CHECK(buttons::msUntilIdle() == DOUBLE_CLICK_DELAY + 1);
+	CHECK(!buttons::sleepUntilEvent());
+	CHECK(sleeps == 0);
+	mockAdvance(DOUBLE_CLICK_DELAY + 1);
+	CHECK(buttons::msUntilIdle() == 0);
+
+	// Wake on a press 5 s later: the press is timestamped with the wake time.
+	unsigned long pressAt = millis() + 5000;
+	mockSchedulePin(pressAt, 4, true);
+	CHECK(buttons::sleepUntilEvent());
+	CHECK(mockInterruptsEnabled());
+	CHECK(millis() == pressAt);
+	CHECK(buttons::eventPending());
+	CHECK(buttons::clicked(0));
+	CHECK(buttons::pressTime(0) == pressAt);
+
+	// Held: not idle until the long release period has passed.
+	CHECK(buttons::msUntilIdle() == LONG_RELEASE_DELAY + 1);
+	CHECK(!buttons::sleepUntilEvent());
+	mockAdvance(LONG_RELEASE_DELAY + 1);
+	CHECK(buttons::msUntilIdle() == 0);
+
+	// A release long after, during sleep, is a long release of the exact duration.
+	unsigned long releaseAt = pressAt + 60000;
+	mockSchedulePin(releaseAt, 4, false);
+	CHECK(buttons::sleepUntilEvent());
+	CHECK(millis() == releaseAt);
+	CHECK(buttons::eventPending());
+	CHECK(buttons::longReleased(0));
+	CHECK(!buttons::shortReleased(0));
+	CHECK(buttons::pressDuration(0) == 60000);
+
+	// An event already pending: returns at once without sleeping.
+	mockAdvance(DOUBLE_CLICK_DELAY + 1);
+	mockSetPin(5, true);
+	mockAdvance(DOUBLE_CLICK_DELAY + 1);
+	unsigned long before = sleeps;
+	CHECK(!buttons::sleepUntilEvent());
+	CHECK(sleeps == before);
+	CHECK(buttons::eventPending());
+	CHECK(buttons::clicked(1));
+
+	// Edges inside the debounce period after a wake are still filtered: the bounce is ignored.
+	mockSetPin(5, false);
+	mockAdvance(DOUBLE_CLICK_DELAY + 1);
+	buttons::eventPending();
+	buttons::shortReleased(1);
+	unsigned long bounceAt = millis() + 1000;
+	mockSchedulePin(bounceAt, 5, true);
+	mockSchedulePin(bounceAt + 5, 5, false);
+	mockSchedulePin(bounceAt + 10, 5, true);
+	CHECK(buttons::sleepUntilEvent());
+	CHECK(buttons::eventPending());
+	CHECK(buttons::clicked(1));
+	CHECK(buttons::msUntilIdle() > 0);
+	mockAdvance(10);
+	CHECK(!buttons::shortReleased(1));
+	CHECK(buttons::down(1));
+
+	// No event: the timeout ends the sleep.
+	mockSetPin(5, false);
+	mockAdvance(LONG_RELEASE_DELAY + 1);
+	buttons::eventPending();
+	unsigned long start = millis();
+	CHECK(buttons::sleepUntilEvent(50));
+	CHECK(millis() - start == 50);
+	CHECK(!buttons::eventPending());
+
+	return hostTestResult("sleep");
+}
@@ -1,62 +1,180 @@
 #include <buttonsSingle.h>
 
-void ButtonSingle::begin(uint8_t buttonPin)
+ButtonSingle* volatile ButtonSingle::_instances[BUTTON_SINGLE_MAX_INSTANCES];
+
+ButtonEventHandler volatile ButtonSingle::_eventHandler = nullptr;
+
+template <uint8_t Slot>
+void ButtonSingle::buttonISR()
 {
-	pin = buttonPin;
-	pinMode(buttonPin, INPUT_PULLUP);
+	ButtonSingle* instance = _instances[Slot];
+	if (instance != nullptr) instance->button_Handler();
+}
+
+/**
+* Finds the ISR of a slot, walking down from the last slot at compile time.
+*/
+template <uint8_t Slot>
+struct ButtonSingle::SlotISR
+{
+	static void (*get(uint8_t slot))()
+	{
+		return slot == Slot ? &ButtonSingle::buttonISR<Slot> : SlotISR<Slot - 1>::get(slot);
+	}
+};
+
+template <>
+struct ButtonSingle::SlotISR<0>
+{
+	static void (*get(uint8_t))()
+	{
+		return &ButtonSingle::buttonISR<0>;
+	}
+};
+
+bool ButtonSingle::begin(uint8_t buttonPin)
+{
+	if (!beginAsync(buttonPin)) return false;
 
 	// Need to wait some time before setting up the ISRs, otherwise you can get spurious
 	// changes as the pullup hasn't quite done its magic yet.
-	delay(10);
+	delay(BUTTON_SETTLE_DELAY);
+	arm();
+	return true;
+}
 
-	//Set up the interrupts on the pin.
-	attachInterrupt(digitalPinToInterrupt(buttonPin), ButtonSingle::buttonISR, CHANGE);
+bool ButtonSingle::beginAsync(uint8_t buttonPin)
+{
+	stop();
+
+	// Take a free slot of the instance table.
+	for (uint8_t i = 0; i < BUTTON_SINGLE_MAX_INSTANCES; i++)
+	{
+		if (_instances[i] == nullptr)
+		{
+			slot = i;
+			_instances[i] = this;
+			break;
+		}
+	}
+	if (slot == NO_SLOT) return false;
+
+	_pin = buttonPin;
+	pinMode(buttonPin, INPUT_PULLUP);
+	start.configured();
+	return true;
+}
+
+bool ButtonSingle::beginFromConfig(const uint8_t config[], uint16_t size)
+{
+	return loadConfig(config, size) && begin(ButtonsConfig::pins(config)[0]);
+}
+
+bool ButtonSingle::update()
+{
+	if (start.begun) return true;
+	if (!start.due()) return false;
+	arm();
+	return true;
+}
+
+void ButtonSingle::arm()
+{
+	//Set up the interrupt on the pin.
+	attachInterrupt(digitalPinToInterrupt(_pin), SlotISR<BUTTON_SINGLE_MAX_INSTANCES - 1>::get(slot), CHANGE);
 
 	// initialize button state
-	state = digitalRead(pin) ? CLEAR_FLAGS : PRESSED_FLAG;
-	lastClickTime = lastChangeTime = millis();
+	state.reset(polledDown(), BUTTONS_NOW());
+	start.armed();
 }
 
 void ButtonSingle::stop()
 {
-	//Disable the interrupts
-	detachInterrupt(digitalPinToInterrupt(pin));
+	// A start still waiting for the pull-up to settle has no interrupt to detach.
+	if (start.stop())
+	{
+		//Disable the interrupt
+		detachInterrupt(digitalPinToInterrupt(_pin));
+	}
+	if (slot != NO_SLOT)
+	{
+		_instances[slot] = nullptr;
+		slot = NO_SLOT;
+	}
 }
 
 void ButtonSingle::button_Handler()
 {
-	uint32_t now = millis();
-	const bool readState = !digitalRead(pin);
-	if (readState != (state && PRESSED_FLAG))
-	{
-		if (now - lastChangeTime > DEBOUNCE_DELAY)
-		{
-			if (readState) // button has been clicked
-			{
-				state = CLEAR_FLAGS;
-				state = PRESSED_FLAG | CLICKED_FLAG;
-
-				if (now - lastClickTime > DOUBLE_CLICK_DELAY)
-				{
-					state |= DOUBLE_CLICKED_FLAG;
-				}
-				lastClickTime = now;
-			}
-			else
-			{ // button has been released
-				state &= ~PRESSED_FLAG;
-				state |= RELEASED_FLAG;
-				if (now - lastClickTime > LONG_CLICK_DELAY)
-				{
-					state |= LONG_CLICKED_FLAG;
-				}
-			}
-		}
-		lastChangeTime = now;
-	}
+	unsigned long now = BUTTONS_NOW();
+	uint8_t raised = state.update(polledDown(), now, timings);
+	if (raised != ButtonState::CLEAR_FLAGS) buttonsRaiseEvent(pending, _eventHandler, _pin, raised, now, state.eventDuration(raised, now));
 }
 
-void ButtonSingle::buttonISR()
+unsigned long ButtonSingle::pressTime()
 {
+	return state.times(BUTTONS_NOW()).press;
+}
 
+unsigned long ButtonSingle::releaseTime()
+{
+	return state.times(BUTTONS_NOW()).release;
+}
+
+unsigned long ButtonSingle::pressDuration()
+{
+	return state.times(BUTTONS_NOW()).duration;
+}
+
+void ButtonSingle::setDebounceDelay(unsigned long ms)
+{
+	ButtonTimings::set(timings.debounce, ms);
+}
+
+void ButtonSingle::setDoubleClickDelay(unsigned long ms)
+{
+	ButtonTimings::set(timings.doubleClick, ms);
+}
+
+void ButtonSingle::setLongReleaseDelay(unsigned long ms)
+{
+	ButtonTimings::set(timings.longRelease, ms);
+}
+
+uint16_t ButtonSingle::saveConfig(uint8_t config[], uint16_t size)
+{
+	if (!ButtonsConfig::writeHeader(config, size, 1, timings)) return 0;
+
+	config[ButtonsConfig::HEADER_SIZE] = _pin;
+	return ButtonsConfig::seal(config, 1);
+}
+
+bool ButtonSingle::loadConfig(const uint8_t config[], uint16_t size)
+{
+	if (!ButtonsConfig::valid(config, size, 1)) return false;
+
+	ButtonsConfig::apply(config, timings);
+	return true;
+}
+
+uint32_t ButtonSingle::msUntilIdle()
+{
+	unsigned long now = BUTTONS_NOW();
+	ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+	unsigned long remaining = state.ticksUntilIdle(now, timings);
+	buttonsRestoreInterrupts(interruptState);
+	return ButtonTimings::roundUpToMs(remaining);
+}
+
+bool ButtonSingle::sleepUntilEvent(uint32_t timeout)
+{
+	if (!start.begun || msUntilIdle() != 0) return false;
+
+	return buttonsSleepUntilEvent(pending, timeout);
+}
+
+void ButtonSingle::setEventHandler(ButtonEventHandler handler)
+{
+	ButtonsInterruptState interruptState = buttonsDisableInterrupts();
+	_eventHandler = handler;
+	buttonsRestoreInterrupts(interruptState);
 }
@@ -24,85 +24,188 @@
 
 #pragma once
 
-#include <Arduino.h>
-
+#include <buttonsTemplate.h>
+
+/**
+* Maximum number of ButtonSingle objects attached at the same time.
+* Can be overridden in user files by #defining it before including this file.
+*/
+#ifndef BUTTON_SINGLE_MAX_INSTANCES
+#define BUTTON_SINGLE_MAX_INSTANCES 4
+#endif
+
+/**
+ * This class manages a single button as an object, for code that prefers instances to the
+ * static Buttons classes. It uses the same ButtonState debounce and click classification as
+ * Buttons, so both behave the same and share the timing periods defined in buttonsTemplate.h.
+ *
+ * Each started object takes a slot in a static instance table. Every slot has its own ISR,
+ * which only reads and classifies the pin of that object. The events are reported to the
+ * handler set with setEventHandler(), with the pin as button index, so ButtonEventQueue
+ * works with this class too.
+ */
 class ButtonSingle
 {
 public:
 
-	void begin(const uint8_t buttonPin);
+	ButtonSingle() = default;
+	~ButtonSingle() { stop(); }
+	ButtonSingle& operator=(const ButtonSingle&) = delete;
+	ButtonSingle(const ButtonSingle&) = delete;
+
+	/**
+	* Initializes the button on the pin and attaches its interrupt.
+	* Returns false if BUTTON_SINGLE_MAX_INSTANCES objects are already attached.
+	*/
+	bool begin(const uint8_t buttonPin);
+
+	/**
+	* Configures the pin without waiting for the pull-up to settle. The interrupt is
+	* attached by the first update() call made BUTTON_SETTLE_DELAY milliseconds later.
+	*/
+	bool beginAsync(const uint8_t buttonPin);
+
+	/**
+	* Completes a start made with beginAsync(). Returns true once the button is running.
+	*/
+	bool update();
 
 	void stop();
 
+	/**
+	* Validates a ButtonsConfig blob of one button, applies its periods and begins on its pin.
+	*/
+	bool beginFromConfig(const uint8_t config[], uint16_t size);
+
 	bool clicked() __attribute__((always_inline))
 	{
-		bool bClicked = state && CLICKED_FLAG;
-		state &= ~CLICKED_FLAG;
-		return bClicked;
+		return state.take(ButtonState::CLICKED_FLAG);
 	}
 
-	bool released() __attribute__((always_inline))
+	bool shortReleased() __attribute__((always_inline))
 	{
-		bool bReleased = state && RELEASED_FLAG;
-		state &= ~RELEASED_FLAG;
-		return bReleased;
+		return state.take(ButtonState::SHORT_RELEASED_FLAG);
 	}
 
-	bool longClicked() __attribute__((always_inline))
+	bool longReleased() __attribute__((always_inline))
 	{
-		bool blongClicked = state && LONG_CLICKED_FLAG;
-		state &= ~LONG_CLICKED_FLAG;
-		return blongClicked;
+		return state.take(ButtonState::LONG_RELEASED_FLAG);
 	}
 
 	bool doubleClicked() __attribute__((always_inline))
 	{
-		bool bDoubleClicked = state && DOUBLE_CLICKED_FLAG;
-		state &= ~DOUBLE_CLICKED_FLAG;
-		return bDoubleClicked;
+		return state.take(ButtonState::DOUBLE_CLICKED_FLAG);
+	}
+
+	/**
+	* Returns true if the button has been released, after a short or a long press.
+	* Clears both release flags.
+	*/
+	bool released() __attribute__((always_inline))
+	{
+		bool bShortReleased = shortReleased();
+		return longReleased() || bShortReleased;
+	}
+
+	/**
+	* Kept for existing sketches: same as longReleased().
+	*/
+	bool longClicked() __attribute__((always_inline))
+	{
+		return longReleased();
 	}
 
 	bool down() __attribute__((always_inline))
 	{
-		return state && PRESSED_FLAG;
+		return (state.state & ButtonState::PRESSED_FLAG) != 0;
 	}
 
-	bool up(uint8_t buttonId) __attribute__((always_inline))
+	bool up() __attribute__((always_inline))
 	{
 		return !down();
 	}
 
-	bool polledDown(uint8_t buttonId) __attribute__((always_inline))
+	bool polledDown() __attribute__((always_inline))
 	{
-		return digitalRead(pin) == LOW;
+		return digitalRead(_pin) == LOW;
 	}
 
-private:
+	uint8_t pin() const __attribute__((always_inline))
+	{
+		return _pin;
+	}
+
+	/**
+	* ISR-captured time of the last press and release, and exact duration of the last press
+	* (or of the current one while the button is down), in BUTTONS_NOW() ticks.
+	*/
+	unsigned long pressTime();
+	unsigned long releaseTime();
+	unsigned long pressDuration();
+
+	/**
+	* Changes the periods used to classify the button edges, in milliseconds.
+	*/
+	void setDebounceDelay(unsigned long ms);
+	void setDoubleClickDelay(unsigned long ms);
+	void setLongReleaseDelay(unsigned long ms);
+
+	/**
+	* Writes the periods and the pin of this object to a ButtonsConfig blob of one button,
+	* and validates such a blob and applies its periods. Same as the Buttons classes.
+	*/
+	uint16_t saveConfig(uint8_t config[], uint16_t size);
+	bool loadConfig(const uint8_t config[], uint16_t size);
+
+	/**
+	* Milliseconds left before the debounce and click windows of this button have closed, and
+	* sleep until it raises an event. Same as ButtonsBase::msUntilIdle() and sleepUntilEvent().
+	*/
+	uint32_t msUntilIdle();
+	bool sleepUntilEvent(uint32_t timeout = 0);
+
+	/**
+	* Returns true if the ISR has raised any new flag since the last call, and clears that indication.
+	*/
+	bool eventPending() __attribute__((always_inline))
+	{
+		return buttonsTakePending(pending);
+	}
 
 	/**
-	* Debounce period in milliseconds.
+	* Sets a function called by the ISRs of every ButtonSingle object for every event they raise,
+	* with the pin as button index, or nullptr to remove it.
 	*/
-	static constexpr unsigned long DEBOUNCE_DELAY = 50;
-	static constexpr unsigned long DOUBLE_CLICK_DELAY = 500;
-	static constexpr unsigned long LONG_CLICK_DELAY = 2000;
+	static void setEventHandler(ButtonEventHandler handler);
 
-	static constexpr uint8_t CLEAR_FLAGS = 0;
-	static constexpr uint8_t PRESSED_FLAG = _BV(0);
-	static constexpr uint8_t CLICKED_FLAG = _BV(1);
-	static constexpr uint8_t RELEASED_FLAG = _BV(2);
-	static constexpr uint8_t LONG_CLICKED_FLAG = _BV(3);
-	static constexpr uint8_t DOUBLE_CLICKED_FLAG = _BV(4);
+private:
+	static constexpr uint8_t NO_SLOT = 0xFF;
+
+	uint8_t _pin = 0;
+	uint8_t slot = NO_SLOT;
+	ButtonsStart start;
+	volatile bool pending = false;
+	volatile ButtonState state;
+	ButtonTimings timings;
 
-	uint8_t pin;
-	uint8_t state;
-	unsigned long lastChangeTime, lastClickTime;
+	void arm();
 
 	/**
-	* This function is called whenever a button interrupt is fired.
-	* It reads all the button states and updates their _buttons objects
-	* accordingly.
+	* This function is called whenever the interrupt of this object's pin is fired.
+	* It reads the pin and updates the state of this object accordingly.
 	*/
 	void button_Handler();
 
+	/**
+	* Table of attached objects, and the ISR of each slot.
+	*/
+	static ButtonSingle* volatile _instances[BUTTON_SINGLE_MAX_INSTANCES];
+
+	static ButtonEventHandler volatile _eventHandler;
+
+	template <uint8_t Slot>
 	static void buttonISR();
+
+	template <uint8_t Slot>
+	struct SlotISR;
 };